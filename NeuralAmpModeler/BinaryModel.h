@@ -0,0 +1,186 @@
+#pragma once
+
+// Models in a binary file (.namb) that loads without parsing any numbers: the same as a .nam file, but with the
+// weights stored as they are in memory instead of as JSON text. tools/convert_model makes them from .nam files and
+// from config.json + weights.npy directories.
+//
+// Layout (all of it little-endian):
+//   0   "NAMB"
+//   4   uint32   Format version (kVersion)
+//   8   uint64   Header size (bytes)
+//   16  uint64   Where the weights start (bytes from the beginning of the file; a multiple of 64)
+//   24  uint64   Number of weights
+//   32  Header: JSON with "version", "architecture", "config", "metadata", and "sample_rate", like a .nam file has
+//       Zeros up to the weights
+//       Weights: float32
+//
+// The file is mapped into memory and the weights are copied from it in one go. (NeuralAmpModelerCore's layers keep
+// their own copies, so they can't be used from the mapping directly.)
+
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../NeuralAmpModelerCore/NAM/get_dsp.h"
+
+#include "MappedFile.h"
+
+namespace binary_model
+{
+const char* const kExtension = ".namb";
+const char kMagic[4] = {'N', 'A', 'M', 'B'};
+const uint32_t kVersion = 1;
+const size_t kPreambleSize = 32;
+const size_t kWeightsAlignment = 64;
+
+inline bool IsBinaryModel(const std::filesystem::path& path)
+{
+  std::string extension = path.extension().string();
+  for (auto& c : extension)
+    c = (char)std::tolower((unsigned char)c);
+  return extension == kExtension;
+}
+
+namespace detail
+{
+inline uint64_t GetLittleEndian(const uint8_t* bytes, const size_t numBytes)
+{
+  uint64_t value = 0;
+  for (size_t i = 0; i < numBytes; i++)
+    value |= (uint64_t)bytes[i] << (8 * i);
+  return value;
+}
+
+inline void PutLittleEndian(std::vector<uint8_t>& bytes, const uint64_t value, const size_t numBytes)
+{
+  for (size_t i = 0; i < numBytes; i++)
+    bytes.push_back((uint8_t)(value >> (8 * i)));
+}
+
+// Little-endian float32s to floats
+inline void CopyWeights(const uint8_t* bytes, const size_t numWeights, std::vector<float>& weights)
+{
+  weights.resize(numWeights);
+  if (numWeights == 0)
+    return;
+  std::memcpy(weights.data(), bytes, numWeights * sizeof(float));
+  if (!IsLittleEndian())
+  {
+    for (auto& w : weights)
+    {
+      uint32_t bits;
+      std::memcpy(&bits, &w, sizeof(bits));
+      bits = (bits >> 24) | ((bits >> 8) & 0xff00) | ((bits << 8) & 0xff0000) | (bits << 24);
+      std::memcpy(&w, &bits, sizeof(bits));
+    }
+  }
+}
+
+// What's in the first kPreambleSize bytes
+struct Preamble
+{
+  uint64_t headerSize = 0;
+  uint64_t weightsStart = 0;
+  uint64_t numWeights = 0;
+};
+
+// Checks it against the file's size too. Throws on failure.
+inline Preamble ReadPreamble(const std::filesystem::path& path, const MappedFile& file)
+{
+  const uint8_t* bytes = file.GetData();
+  const size_t size = file.GetSize();
+  if (size < kPreambleSize || std::memcmp(bytes, kMagic, sizeof(kMagic)) != 0)
+    throw std::runtime_error(path.string() + " isn't a binary model");
+  const uint64_t version = GetLittleEndian(bytes + 4, 4);
+  if (version != kVersion)
+  {
+    throw std::runtime_error(path.string() + " is a binary model of version " + std::to_string(version)
+                             + ", which this version of the plugin can't read");
+  }
+  Preamble preamble;
+  preamble.headerSize = GetLittleEndian(bytes + 8, 8);
+  preamble.weightsStart = GetLittleEndian(bytes + 16, 8);
+  preamble.numWeights = GetLittleEndian(bytes + 24, 8);
+  if (preamble.headerSize > size - kPreambleSize || preamble.weightsStart < kPreambleSize + preamble.headerSize
+      || preamble.weightsStart > size || preamble.numWeights > (size - preamble.weightsStart) / sizeof(float))
+  {
+    throw std::runtime_error(path.string() + " is cut short or corrupted");
+  }
+  return preamble;
+}
+
+inline void ReadHeader(const MappedFile& file, const Preamble& preamble, nam::dspData& data)
+{
+  const char* header = (const char*)file.GetData() + kPreambleSize;
+  const nlohmann::json j = nlohmann::json::parse(header, header + preamble.headerSize);
+  data.version = j.at("version").get<std::string>();
+  data.architecture = j.at("architecture").get<std::string>();
+  data.config = j.at("config");
+  data.metadata = j.value("metadata", nlohmann::json());
+  data.expected_sample_rate = j.value("sample_rate", -1.0);
+}
+}; // namespace detail
+
+// Throws on failure.
+inline void Read(const std::filesystem::path& path, nam::dspData& data)
+{
+  const MappedFile file(path);
+  const detail::Preamble preamble = detail::ReadPreamble(path, file);
+  detail::ReadHeader(file, preamble, data);
+  detail::CopyWeights(file.GetData() + preamble.weightsStart, (size_t)preamble.numWeights, data.weights);
+}
+
+// Everything except the weights. Throws on failure.
+inline void ReadHeader(const std::filesystem::path& path, nam::dspData& data)
+{
+  const MappedFile file(path);
+  detail::ReadHeader(file, detail::ReadPreamble(path, file), data);
+}
+
+// Only the weights. Throws on failure.
+inline void ReadWeights(const std::filesystem::path& path, std::vector<float>& weights)
+{
+  const MappedFile file(path);
+  const detail::Preamble preamble = detail::ReadPreamble(path, file);
+  detail::CopyWeights(file.GetData() + preamble.weightsStart, (size_t)preamble.numWeights, weights);
+}
+
+// Throws on failure.
+inline void Write(const std::filesystem::path& path, const nam::dspData& data)
+{
+  nlohmann::json j;
+  j["version"] = data.version;
+  j["architecture"] = data.architecture;
+  j["config"] = data.config;
+  j["metadata"] = data.metadata;
+  j["sample_rate"] = data.expected_sample_rate;
+  const std::string header = j.dump();
+  size_t weightsStart = kPreambleSize + header.size();
+  weightsStart += (kWeightsAlignment - weightsStart % kWeightsAlignment) % kWeightsAlignment;
+
+  std::vector<uint8_t> bytes(kMagic, kMagic + sizeof(kMagic));
+  detail::PutLittleEndian(bytes, kVersion, 4);
+  detail::PutLittleEndian(bytes, header.size(), 8);
+  detail::PutLittleEndian(bytes, weightsStart, 8);
+  detail::PutLittleEndian(bytes, data.weights.size(), 8);
+  bytes.insert(bytes.end(), header.begin(), header.end());
+  bytes.resize(weightsStart, 0);
+  for (const float w : data.weights)
+  {
+    uint32_t bits;
+    std::memcpy(&bits, &w, sizeof(bits));
+    detail::PutLittleEndian(bytes, bits, 4);
+  }
+
+  std::ofstream out(path, std::ios::binary);
+  out.write((const char*)bytes.data(), (std::streamsize)bytes.size());
+  out.close();
+  if (!out)
+    throw std::runtime_error("Can't write " + path.string());
+}
+}; // namespace binary_model
@@ -0,0 +1,105 @@
+#pragma once
+
+// Biquad coefficients and state, so that filters can be cascaded in a single loop.
+// The designs are the RBJ Audio EQ Cookbook ones, the same as AudioDSPTools' recursive_linear_filter.
+
+#include <cmath>
+
+#include "../AudioDSPTools/dsp/dsp.h" // MATH_PI
+
+namespace dsp
+{
+namespace biquad
+{
+// y[n] = b0 x[n] + b1 x[n-1] + b2 x[n-2] - a1 y[n-1] - a2 y[n-2]
+// (i.e. normalized so that a0 is 1). The default passes the input through.
+struct Coefficients
+{
+  double b0 = 1.0;
+  double b1 = 0.0;
+  double b2 = 0.0;
+  double a1 = 0.0;
+  double a2 = 0.0;
+
+  static Coefficients LowShelf(const double sampleRate, const double frequency, const double quality,
+                               const double gainDB)
+  {
+    const double a = std::pow(10.0, gainDB / 40.0);
+    const double w0 = 2.0 * MATH_PI * frequency / sampleRate;
+    const double cosw = std::cos(w0);
+    const double alpha = std::sin(w0) / (2.0 * quality);
+    const double ap = a + 1.0;
+    const double am = a - 1.0;
+    const double roota2alpha = 2.0 * std::sqrt(a) * alpha;
+    return _Normalized(a * (ap - am * cosw + roota2alpha), 2.0 * a * (am - ap * cosw),
+                       a * (ap - am * cosw - roota2alpha), ap + am * cosw + roota2alpha, -2.0 * (am + ap * cosw),
+                       ap + am * cosw - roota2alpha);
+  };
+
+  static Coefficients Peaking(const double sampleRate, const double frequency, const double quality,
+                              const double gainDB)
+  {
+    const double a = std::pow(10.0, gainDB / 40.0);
+    const double w0 = 2.0 * MATH_PI * frequency / sampleRate;
+    const double cosw = std::cos(w0);
+    const double alpha = std::sin(w0) / (2.0 * quality);
+    return _Normalized(
+      1.0 + alpha * a, -2.0 * cosw, 1.0 - alpha * a, 1.0 + alpha / a, -2.0 * cosw, 1.0 - alpha / a);
+  };
+
+  static Coefficients HighShelf(const double sampleRate, const double frequency, const double quality,
+                                const double gainDB)
+  {
+    const double a = std::pow(10.0, gainDB / 40.0);
+    const double w0 = 2.0 * MATH_PI * frequency / sampleRate;
+    const double cosw = std::cos(w0);
+    const double alpha = std::sin(w0) / (2.0 * quality);
+    const double ap = a + 1.0;
+    const double am = a - 1.0;
+    const double roota2alpha = 2.0 * std::sqrt(a) * alpha;
+    return _Normalized(a * (ap + am * cosw + roota2alpha), -2.0 * a * (am + ap * cosw),
+                       a * (ap + am * cosw - roota2alpha), ap - am * cosw + roota2alpha, 2.0 * (am - ap * cosw),
+                       ap - am * cosw - roota2alpha);
+  };
+
+  // First-order high-pass (like recursive_linear_filter::HighPass): y[n] = alpha * (y[n-1] + x[n] - x[n-1])
+  static Coefficients HighPass(const double sampleRate, const double frequency)
+  {
+    const double alpha = 1.0 / (1.0 + 2.0 * MATH_PI * frequency / sampleRate);
+    Coefficients c;
+    c.b0 = alpha;
+    c.b1 = -alpha;
+    c.a1 = -alpha;
+    return c;
+  };
+
+private:
+  static Coefficients _Normalized(const double b0, const double b1, const double b2, const double a0,
+                                  const double a1, const double a2)
+  {
+    Coefficients c;
+    c.b0 = b0 / a0;
+    c.b1 = b1 / a0;
+    c.b2 = b2 / a0;
+    c.a1 = a1 / a0;
+    c.a2 = a2 / a0;
+    return c;
+  };
+};
+
+// Transposed direct form II. Kept in double whatever DSP_SAMPLE is, since the DC blocker is very low.
+struct State
+{
+  double z1 = 0.0;
+  double z2 = 0.0;
+
+  double Process(const Coefficients& c, const double x)
+  {
+    const double y = c.b0 * x + z1;
+    z1 = c.b1 * x - c.a1 * y + z2;
+    z2 = c.b2 * x - c.a2 * y;
+    return y;
+  };
+};
+}; // namespace biquad
+}; // namespace dsp
@@ -0,0 +1,175 @@
+#pragma once
+
+// The noise gate, worked out a block at a time.
+// Same behavior as AudioDSPTools' noise_gate::Trigger and Gain: an exponential power envelope of the input, held open
+// for a while after it drops below the threshold, then a quadratic (in dB) gain reduction that opens and closes at
+// limited rates. (Except that it finishes opening; see kOpenDB.)
+// The difference is in what it costs:
+// * The envelope is compared with the threshold as a power, so the logs and exps are only needed while the gate is
+//   actually moving.
+// * If it's open for the whole block, there's no gain to apply at all (Process() returns false).
+// * If it's shut for the whole block and the input stays at the floor, the gain is the same for every sample.
+// * The gain comes out as a curve that the processing chain applies along with its other filters (see
+//   PostModelFilters.h) instead of in its own pass.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#include "../AudioDSPTools/dsp/dsp.h"
+
+class BlockNoiseGate
+{
+public:
+  struct Params
+  {
+    // Time constant of the envelope (seconds)
+    double time = 0.01;
+    double threshold = -80.0; // dB
+    // Gain reduction (dB) is ratio * (dB below threshold)^2
+    double ratio = 0.1;
+    // Seconds
+    double openTime = 0.005;
+    double holdTime = 0.01;
+    double closeTime = 0.05;
+  };
+
+  BlockNoiseGate() { _UpdateCoefficients(); };
+
+  void SetParams(const Params& params)
+  {
+    mParams = params;
+    _UpdateCoefficients();
+  };
+  void SetSampleRate(const double sampleRate)
+  {
+    mSampleRate = sampleRate;
+    _UpdateCoefficients();
+  };
+  // Back to shut, with no signal
+  void Reset()
+  {
+    mLevel = kMinimumLevel;
+    mHolding = false;
+    mTimeHeld = 0.0;
+    mGainReductionDB = mMaxGainReductionDB;
+    mGain = _DBToGain(mGainReductionDB);
+  };
+
+  // Tracks the input and writes the gain to apply to each sample.
+  // :return: false if the gain is 1 for the whole block, in which case nothing was written.
+  bool Process(const DSP_SAMPLE* input, DSP_SAMPLE* gain, const size_t numFrames)
+  {
+    double level = mLevel;
+    bool wroteGain = false;
+    for (size_t s = 0; s < numFrames; s++)
+    {
+      const double x = input[s];
+      level = std::min(std::max(mAlpha * level + mBeta * x * x, kMinimumLevel), kMaximumLevel);
+      if (mHolding)
+      {
+        if (level < mThresholdLevel)
+        {
+          mTimeHeld += mDt;
+          if (mTimeHeld >= mParams.holdTime)
+            mHolding = false;
+        }
+        else
+          mTimeHeld = 0.0;
+        if (wroteGain)
+          gain[s] = (DSP_SAMPLE)1.0;
+        continue;
+      }
+      // Moving
+      if (!wroteGain)
+      {
+        // Everything before this was open.
+        std::fill(gain, gain + s, (DSP_SAMPLE)1.0);
+        wroteGain = true;
+      }
+      // Shut and staying shut: the rest of the block is the same unless the input comes up off the floor.
+      if (level == kMinimumLevel && mGainReductionDB == mMaxGainReductionDB)
+      {
+        gain[s] = (DSP_SAMPLE)mGain;
+        continue;
+      }
+      const double target = level >= mThresholdLevel ? 0.0 : _GetGainReductionDB(10.0 * std::log10(level));
+      const double previous = mGainReductionDB;
+      if (target > mGainReductionDB)
+      {
+        mGainReductionDB += std::min(0.5 * (target - mGainReductionDB), mOpenRate);
+        if (mGainReductionDB >= -kOpenDB)
+        {
+          mGainReductionDB = 0.0;
+          mHolding = true;
+          mTimeHeld = 0.0;
+        }
+      }
+      else if (target < mGainReductionDB)
+      {
+        mGainReductionDB += std::max(0.5 * (target - mGainReductionDB), mCloseRate);
+        mGainReductionDB = std::max(mGainReductionDB, mMaxGainReductionDB);
+      }
+      if (mGainReductionDB != previous)
+        mGain = _DBToGain(mGainReductionDB);
+      gain[s] = (DSP_SAMPLE)mGain;
+    }
+    mLevel = level;
+    return wroteGain;
+  };
+
+private:
+  // Envelope limits (power), as in AudioDSPTools
+  static constexpr double kMinimumLevelDB = -120.0;
+  static constexpr double kMinimumLevel = 1.0e-12;
+  static constexpr double kMaximumLevel = 1000.0;
+  // Opening halves the gain reduction every sample, which only gets to exactly 0 dB by underflowing (or never, with
+  // denormals flushed), so AudioDSPTools' gate never gets to holding. This is close enough to call it open; it's a
+  // smaller step than a float can take near 1.
+  static constexpr double kOpenDB = 1.0e-6;
+
+  double _GetGainReductionDB(const double levelDB) const
+  {
+    const double below = levelDB - mParams.threshold;
+    return levelDB < mParams.threshold ? -mParams.ratio * below * below : 0.0;
+  };
+  static double _DBToGain(const double db) { return std::pow(10.0, db / 20.0); };
+  void _UpdateCoefficients()
+  {
+    mAlpha = std::pow(0.5, 1.0 / (mParams.time * mSampleRate));
+    mBeta = 1.0 - mAlpha;
+    mDt = 1.0 / mSampleRate;
+    mThresholdLevel = std::pow(10.0, mParams.threshold / 10.0);
+    const double previousMax = mMaxGainReductionDB;
+    mMaxGainReductionDB = _GetGainReductionDB(kMinimumLevelDB);
+    // dB per sample
+    mOpenRate = -mMaxGainReductionDB / mParams.openTime * mDt;
+    mCloseRate = mMaxGainReductionDB / mParams.closeTime * mDt;
+    // Stay within the new limits.
+    if (mGainReductionDB == previousMax || mGainReductionDB < mMaxGainReductionDB)
+    {
+      mGainReductionDB = mMaxGainReductionDB;
+      mGain = _DBToGain(mGainReductionDB);
+    }
+  };
+
+  Params mParams;
+  double mSampleRate = 48000.0;
+
+  // From the params
+  double mAlpha = 0.0;
+  double mBeta = 0.0;
+  double mDt = 0.0;
+  double mThresholdLevel = 0.0;
+  double mMaxGainReductionDB = 0.0;
+  double mOpenRate = 0.0;
+  double mCloseRate = 0.0;
+
+  // State
+  double mLevel = kMinimumLevel;
+  bool mHolding = false;
+  double mTimeHeld = 0.0;
+  double mGainReductionDB = 0.0;
+  // _DBToGain(mGainReductionDB)
+  double mGain = 1.0;
+};
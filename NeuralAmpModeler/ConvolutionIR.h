@@ -0,0 +1,69 @@
+#pragma once
+
+// An IR at one sample rate, convolved with PartitionedConvolution instead of in the time domain.
+// The taps and their filter come from an IRSource, which keeps them for every sample rate that they've been made at
+// (and shares them with whoever else has the same IR). Only the convolution state is this one's own.
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "../AudioDSPTools/dsp/dsp.h"
+
+#include "IRSource.h"
+#include "PartitionedConvolution.h"
+
+class ConvolutionIR
+{
+public:
+  // Resamples if the source doesn't have the taps at sampleRate yet, so not on the audio thread.
+  // :param maxBlockSize: What the host will send (see PartitionedConvolution::ChooseLayout()). Process() takes no
+  //     more than this at once.
+  ConvolutionIR(std::shared_ptr<IRSource> source, const double sampleRate, const int maxBlockSize,
+                const size_t numChannels = 1)
+  : mSource(std::move(source))
+  , mSampleRate(sampleRate)
+  , mMaxBlockSize(std::max(maxBlockSize, 1))
+  , mTaps(mSource->GetTaps(sampleRate))
+  {
+    mConvolutions.reserve(std::max(numChannels, (size_t)1));
+    mConvolutions.emplace_back(mSource->GetFilter(sampleRate, maxBlockSize));
+    while (mConvolutions.size() < numChannels)
+      mConvolutions.push_back(mConvolutions.front());
+    mConvolved.assign(mConvolutions.size(), std::vector<DSP_SAMPLE>((size_t)mMaxBlockSize));
+    for (auto& convolved : mConvolved)
+      mConvolvedPointers.push_back(convolved.data());
+  };
+
+  // Never allocates. Up to the number of channels and maxBlockSize frames that it was made for; split bigger blocks
+  // up (ProcessingChain::ProcessIR() does).
+  DSP_SAMPLE** Process(DSP_SAMPLE** inputs, const size_t numChannels, const size_t numFrames)
+  {
+    assert(numChannels <= mConvolutions.size() && numFrames <= (size_t)mMaxBlockSize);
+    const size_t channels = std::min(numChannels, mConvolutions.size());
+    const size_t frames = std::min(numFrames, (size_t)mMaxBlockSize);
+    for (size_t c = 0; c < channels; c++)
+      mConvolutions[c].Process(inputs[c], mConvolvedPointers[c], frames);
+    return mConvolvedPointers.data();
+  };
+
+  double GetSampleRate() const { return mSampleRate; };
+  int GetMaxBlockSize() const { return mMaxBlockSize; };
+  // Taps
+  size_t GetLength() const { return mTaps->size(); };
+  const std::vector<float>& GetTaps() const { return *mTaps; };
+  // For making it again at another sample rate
+  const std::shared_ptr<IRSource>& GetSource() const { return mSource; };
+
+private:
+  std::shared_ptr<IRSource> mSource;
+  double mSampleRate;
+  int mMaxBlockSize;
+  std::shared_ptr<const IRSource::Taps> mTaps;
+  // One per channel, all with the same filter
+  std::vector<dsp::PartitionedConvolution> mConvolutions;
+  std::vector<std::vector<DSP_SAMPLE>> mConvolved;
+  std::vector<DSP_SAMPLE*> mConvolvedPointers;
+};
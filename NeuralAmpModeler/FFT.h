@@ -0,0 +1,133 @@
+#pragma once
+
+// A real FFT for the convolution engine (see PartitionedConvolution.h), in single precision like the IRs (RealFFT).
+// Radix-2, with everything that depends on the size worked out in the constructor, so that transforms don't allocate.
+// Analysis that can't live with single precision's noise floor (see IRProcessing.h) uses BasicRealFFT<double>.
+
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../AudioDSPTools/dsp/dsp.h" // MATH_PI
+
+namespace dsp
+{
+template <typename T>
+class BasicRealFFT
+{
+public:
+  using Complex = std::complex<T>;
+
+  // :param size: A power of 2, at least 4
+  explicit BasicRealFFT(const size_t size)
+  : mSize(size)
+  , mHalf(size / 2)
+  {
+    if (size < 4 || (size & (size - 1)) != 0)
+      throw std::runtime_error("FFT size " + std::to_string(size) + " isn't a power of 2 of at least 4!");
+    // The real transform is a complex one of half the size, plus a pass to untangle the even and odd samples.
+    mBitReversed.resize(mHalf);
+    size_t bits = 0;
+    while (((size_t)1 << bits) < mHalf)
+      bits++;
+    for (size_t i = 0; i < mHalf; i++)
+    {
+      size_t reversed = 0;
+      for (size_t b = 0; b < bits; b++)
+        reversed |= ((i >> b) & 1) << (bits - 1 - b);
+      mBitReversed[i] = reversed;
+    }
+    mTwiddles.resize(mHalf / 2);
+    for (size_t k = 0; k < mTwiddles.size(); k++)
+      mTwiddles[k] = _Unit(-2.0 * MATH_PI * (double)k / (double)mHalf);
+    mUntangle.resize(mHalf + 1);
+    for (size_t k = 0; k <= mHalf; k++)
+      mUntangle[k] = _Unit(-2.0 * MATH_PI * (double)k / (double)mSize);
+    mScratch.resize(mHalf);
+  };
+
+  size_t GetSize() const { return mSize; };
+  // How many bins a spectrum has
+  size_t GetNumBins() const { return mHalf + 1; };
+
+  // input: GetSize() samples. output: GetNumBins() bins, DC to Nyquist.
+  void Forward(const T* input, Complex* output)
+  {
+    for (size_t i = 0; i < mHalf; i++)
+      mScratch[mBitReversed[i]] = Complex(input[2 * i], input[2 * i + 1]);
+    _Transform(mScratch.data());
+    // Z = E + iO, where E and O are the spectra of the even and odd samples.
+    for (size_t k = 0; k <= mHalf; k++)
+    {
+      const Complex z = mScratch[k % mHalf];
+      const Complex zMirror = std::conj(mScratch[(mHalf - k) % mHalf]);
+      const Complex even = (T)0.5 * (z + zMirror);
+      const Complex odd = Multiply(Complex(0.0, -0.5), z - zMirror);
+      output[k] = even + Multiply(mUntangle[k], odd);
+    }
+  };
+  // The inverse of Forward(), scaling included. input: GetNumBins() bins. output: GetSize() samples.
+  void Inverse(const Complex* input, T* output)
+  {
+    // Tangle them back up into one complex spectrum, conjugated so that the forward transform runs it backwards.
+    for (size_t k = 0; k < mHalf; k++)
+    {
+      const Complex x = input[k];
+      const Complex xMirror = std::conj(input[mHalf - k]);
+      const Complex even = (T)0.5 * (x + xMirror);
+      const Complex odd = Multiply((T)0.5 * (x - xMirror), std::conj(mUntangle[k]));
+      mScratch[mBitReversed[k]] = std::conj(even + Multiply(Complex(0.0, 1.0), odd));
+    }
+    _Transform(mScratch.data());
+    const T scale = (T)1.0 / (T)mHalf;
+    for (size_t i = 0; i < mHalf; i++)
+    {
+      output[2 * i] = scale * mScratch[i].real();
+      output[2 * i + 1] = -scale * mScratch[i].imag();
+    }
+  };
+
+  // Without std::complex's checks for infinities, which keep it from being inlined
+  static Complex Multiply(const Complex a, const Complex b)
+  {
+    return Complex(a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real());
+  };
+
+private:
+  static Complex _Unit(const double angle) { return Complex((T)std::cos(angle), (T)std::sin(angle)); };
+  // In place, on bit-reversed input
+  void _Transform(Complex* data) const
+  {
+    for (size_t length = 2; length <= mHalf; length *= 2)
+    {
+      const size_t half = length / 2;
+      const size_t stride = mHalf / length;
+      for (size_t start = 0; start < mHalf; start += length)
+      {
+        Complex* a = data + start;
+        Complex* b = a + half;
+        for (size_t k = 0; k < half; k++)
+        {
+          const Complex t = Multiply(mTwiddles[k * stride], b[k]);
+          b[k] = a[k] - t;
+          a[k] += t;
+        }
+      }
+    }
+  };
+
+  const size_t mSize;
+  const size_t mHalf;
+  std::vector<size_t> mBitReversed;
+  // For the half-size complex transform
+  std::vector<Complex> mTwiddles;
+  // For getting between that and the real one
+  std::vector<Complex> mUntangle;
+  std::vector<Complex> mScratch;
+};
+
+using RealFFT = BasicRealFFT<float>;
+}; // namespace dsp
@@ -0,0 +1,31 @@
+#pragma once
+
+// Telling files apart by what's in them, for the stores that share what's loaded between plugin instances
+// (IRStore.h, ModelStore.h). FNV-1a: not cryptographic, just quick and well-spread.
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+const uint64_t kFileHashSeed = 14695981039346656037ull;
+
+// Folds the file's contents into hash (start from kFileHashSeed). Returns false if it can't be read.
+inline bool HashFile(const std::filesystem::path& path, uint64_t& hash)
+{
+  std::ifstream file(path, std::ios::binary);
+  if (!file)
+    return false;
+  std::vector<char> buffer(1 << 16);
+  while (file)
+  {
+    file.read(buffer.data(), buffer.size());
+    const std::streamsize numRead = file.gcount();
+    for (std::streamsize i = 0; i < numRead; i++)
+    {
+      hash ^= (uint64_t)(unsigned char)buffer[i];
+      hash *= 1099511628211ull;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+// What can be done to an IR's taps when it's loaded, so that the convolution only pays for the part that's heard.
+// * Trimming cuts off the tail once what's left of the energy is below a threshold (relative to all of it).
+//   Lots of IRs are half a second or more long and almost all of that is down in the noise floor.
+// * Minimum phase keeps the magnitude response and moves the energy as early as it can go. That takes out any
+//   delay before the IR starts and makes it decay sooner, so it trims shorter. It does change the phase response.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include "FFT.h"
+
+namespace dsp
+{
+// dB
+const double kDefaultIRTrimThreshold = -90.0;
+
+struct IRProcessing
+{
+  bool trim = false;
+  // dB. How much of the energy can go (relative to all of it).
+  double trimThreshold = kDefaultIRTrimThreshold;
+  bool minimumPhase = false;
+
+  bool operator==(const IRProcessing& other) const
+  {
+    return trim == other.trim && trimThreshold == other.trimThreshold && minimumPhase == other.minimumPhase;
+  };
+  bool operator!=(const IRProcessing& other) const { return !(*this == other); };
+};
+
+namespace ir_processing
+{
+// Taps trimmed off the end get faded out over (up to) this many
+const size_t kTrimFadeLength = 64;
+// Magnitudes are kept at least this far up (dB relative to the peak) for the logarithm in MakeMinimumPhase().
+const double kMinimumPhaseFloor = -120.0;
+
+// How many taps to keep so that what's cut off has no more than thresholdDB of the energy.
+// Returns the length as it is if it's all zeros.
+inline size_t GetTrimmedLength(const std::vector<float>& taps, const double thresholdDB)
+{
+  double total = 0.0;
+  for (const float tap : taps)
+    total += (double)tap * (double)tap;
+  if (total <= 0.0)
+    return taps.size();
+  const double allowed = total * std::pow(10.0, thresholdDB / 10.0);
+  // Walk in from the end until the tail has too much energy to drop.
+  double tail = 0.0;
+  size_t length = taps.size();
+  while (length > 1)
+  {
+    const double tap = (double)taps[length - 1];
+    if (tail + tap * tap > allowed)
+      break;
+    tail += tap * tap;
+    length--;
+  }
+  return length;
+};
+
+// Cuts off the tail (see GetTrimmedLength()), with a short fade-out so it doesn't stop on a step.
+inline void Trim(std::vector<float>& taps, const double thresholdDB)
+{
+  const size_t length = GetTrimmedLength(taps, thresholdDB);
+  if (length >= taps.size())
+    return;
+  taps.resize(length);
+  const size_t fadeLength = std::min(kTrimFadeLength, length / 4);
+  for (size_t i = 0; i < fadeLength; i++)
+  {
+    // Half a cosine, from just under 1 down to just over 0
+    const double t = (double)(i + 1) / (double)(fadeLength + 1);
+    taps[length - fadeLength + i] *= (float)(0.5 * (1.0 + std::cos(MATH_PI * t)));
+  }
+};
+
+// The minimum-phase IR with the same magnitude response, the same length as the original.
+// Homomorphic: fold the real cepstrum of the log magnitude onto positive time and exponentiate. The FFT is a few
+// times longer than the IR so that the cepstrum doesn't wrap around (much). In double precision, since single
+// precision's noise floor, spread over the whole IR, is about where trimming would cut.
+inline std::vector<float> MakeMinimumPhase(const std::vector<float>& taps)
+{
+  if (taps.size() < 2)
+    return taps;
+  using FFT = BasicRealFFT<double>;
+  size_t size = 4;
+  while (size < 4 * taps.size())
+    size *= 2;
+  FFT fft(size);
+  const size_t numBins = fft.GetNumBins();
+  std::vector<double> time(size, 0.0);
+  std::vector<FFT::Complex> spectrum(numBins);
+
+  std::copy(taps.begin(), taps.end(), time.begin());
+  fft.Forward(time.data(), spectrum.data());
+  double peak = 0.0;
+  for (const auto& bin : spectrum)
+    peak = std::max(peak, std::abs(bin));
+  if (peak <= 0.0)
+    return taps;
+  const double floor = peak * std::pow(10.0, kMinimumPhaseFloor / 20.0);
+  for (auto& bin : spectrum)
+    bin = FFT::Complex(std::log(std::max(std::abs(bin), floor)), 0.0);
+
+  // Real cepstrum, then fold it
+  fft.Inverse(spectrum.data(), time.data());
+  for (size_t n = 1; n < size / 2; n++)
+    time[n] *= 2.0;
+  std::fill(time.begin() + size / 2 + 1, time.end(), 0.0);
+
+  fft.Forward(time.data(), spectrum.data());
+  for (auto& bin : spectrum)
+    bin = std::exp(bin.real()) * FFT::Complex(std::cos(bin.imag()), std::sin(bin.imag()));
+  fft.Inverse(spectrum.data(), time.data());
+  return std::vector<float>(time.begin(), time.begin() + taps.size());
+};
+
+inline void Apply(const IRProcessing& processing, std::vector<float>& taps)
+{
+  if (processing.minimumPhase)
+    taps = MakeMinimumPhase(taps);
+  if (processing.trim)
+    Trim(taps, processing.trimThreshold);
+};
+}; // namespace ir_processing
+}; // namespace dsp
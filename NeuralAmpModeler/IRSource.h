@@ -0,0 +1,173 @@
+#pragma once
+
+// An IR as it was loaded, along with its taps at every sample rate that it's been needed at, and their partitioned
+// convolution filters (spectra) for every layout.
+// Going back to a sample rate (e.g. switching projects between 44.1 and 48 kHz) finds the taps from last time
+// instead of resampling again. ConvolutionIR holds on to the source it came from so that the loader can make it
+// again at another sample rate. None of it changes once it's made, so it's shared between plugin instances too (see
+// IRStore.h); each ConvolutionIR only has its own convolution state.
+//
+// Loading, resampling, level, and truncation are all AudioDSPTools'. The taps are read back out of its
+// dsp::ImpulseResponse by sending an impulse through, so that they're exactly what it would have convolved with.
+// Then they get the source's IRProcessing (trimming, etc.).
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "../AudioDSPTools/dsp/ImpulseResponse.h"
+#include "../AudioDSPTools/dsp/wav.h"
+
+#include "IRProcessing.h"
+#include "PartitionedConvolution.h"
+
+class IRSource
+{
+public:
+  using Taps = std::vector<float>;
+  using Filter = dsp::PartitionedConvolution::Filter;
+  using Layout = dsp::PartitionedConvolution::Layout;
+
+  // Reads a WAV file, and gets the taps at sampleRate while it's at it. Check GetWavState().
+  IRSource(const char* fileName, const double sampleRate, const dsp::IRProcessing& processing = {})
+  : mProcessing(processing)
+  {
+    dsp::ImpulseResponse ir(fileName, sampleRate);
+    mWavState = ir.GetWavState();
+    if (mWavState != dsp::wav::LoadReturnCode::SUCCESS)
+      return;
+    mData = ir.GetData();
+    mVariants[sampleRate] = _MakeVariant(ir, sampleRate);
+  };
+  explicit IRSource(const dsp::ImpulseResponse::IRData& data, const dsp::IRProcessing& processing = {})
+  : mData(data)
+  , mProcessing(processing)
+  {
+  }
+  IRSource(const IRSource&) = delete;
+  IRSource& operator=(const IRSource&) = delete;
+
+  dsp::wav::LoadReturnCode GetWavState() const { return mWavState; };
+  // As loaded
+  const dsp::ImpulseResponse::IRData& GetData() const { return mData; };
+  const dsp::IRProcessing& GetProcessing() const { return mProcessing; };
+
+  // Not on the audio thread.
+  // Resamples if they haven't been made for this sample rate yet, which can take a while.
+  std::shared_ptr<const Taps> GetTaps(const double sampleRate)
+  {
+    if (std::shared_ptr<const Taps> taps = FindTaps(sampleRate))
+      return taps;
+    // Not under the lock, so that looking up other rates doesn't wait. Two threads could both make the same taps;
+    // the first one in is kept.
+    dsp::ImpulseResponse ir(mData, sampleRate);
+    Variant variant = _MakeVariant(ir, sampleRate);
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mVariants.emplace(sampleRate, std::move(variant)).first->second.taps;
+  };
+  // Null if they haven't been made for this sample rate.
+  std::shared_ptr<const Taps> FindTaps(const double sampleRate) const
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mVariants.find(sampleRate);
+    return it != mVariants.end() ? it->second.taps : nullptr;
+  };
+  // Not on the audio thread.
+  // Like GetTaps(), then the filter to convolve with them for this block size (see PartitionedConvolution).
+  std::shared_ptr<const Filter> GetFilter(const double sampleRate, const int maxBlockSize)
+  {
+    std::shared_ptr<const Taps> taps = GetTaps(sampleRate);
+    const Layout layout = dsp::PartitionedConvolution::ChooseLayout(taps->size(), (size_t)std::max(maxBlockSize, 1));
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      if (std::shared_ptr<const Filter> filter = _FindFilter(sampleRate, layout))
+        return filter;
+    }
+    // Same as the taps: not under the lock, and the first one in is kept.
+    auto filter = std::make_shared<const Filter>(taps->data(), taps->size(), layout);
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (std::shared_ptr<const Filter> existing = _FindFilter(sampleRate, layout))
+      return existing;
+    mVariants[sampleRate].filters.emplace_back(layout, filter);
+    return filter;
+  };
+  // How many taps there were at this sample rate before the processing (0 if they haven't been made).
+  size_t GetUnprocessedLength(const double sampleRate) const
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mVariants.find(sampleRate);
+    return it != mVariants.end() ? it->second.unprocessedLength : 0;
+  };
+
+private:
+  // Longer than AudioDSPTools lets IRs be, in case that changes
+  static constexpr size_t kMaxLength = 1 << 16;
+  static constexpr size_t kReadBackChunk = 1024;
+
+  struct Variant
+  {
+    std::shared_ptr<const Taps> taps;
+    size_t unprocessedLength = 0;
+    // By the layout they were asked for
+    std::vector<std::pair<Layout, std::shared_ptr<const Filter>>> filters;
+  };
+
+  // Call with mMutex locked.
+  std::shared_ptr<const Filter> _FindFilter(const double sampleRate, const Layout& layout) const
+  {
+    auto it = mVariants.find(sampleRate);
+    if (it == mVariants.end())
+      return nullptr;
+    for (const auto& filter : it->second.filters)
+      if (filter.first == layout)
+        return filter.second;
+    return nullptr;
+  };
+
+  Variant _MakeVariant(dsp::ImpulseResponse& ir, const double sampleRate) const
+  {
+    // What's in the file, resampled, plus a chunk for the resampler's filter. AudioDSPTools can only cut that down.
+    const double length = mData.mRawAudioSampleRate > 0.0
+                            ? std::ceil((double)mData.mRawAudio.size() * sampleRate / mData.mRawAudioSampleRate)
+                            : (double)kMaxLength;
+    const size_t maxLength = std::min(kMaxLength, (size_t)std::min(length, (double)kMaxLength) + kReadBackChunk);
+    Taps taps = _ReadBackTaps(ir, maxLength);
+    Variant variant;
+    variant.unprocessedLength = taps.size();
+    dsp::ir_processing::Apply(mProcessing, taps);
+    variant.taps = std::make_shared<const Taps>(std::move(taps));
+    return variant;
+  };
+
+  // The time-domain convolution's response to an impulse, for as long as it could be (so that a run of zeros in the
+  // middle of an IR isn't taken for its end), without the zeros at the end.
+  static Taps _ReadBackTaps(dsp::ImpulseResponse& ir, const size_t maxLength)
+  {
+    Taps taps;
+    taps.reserve(maxLength + kReadBackChunk);
+    std::vector<DSP_SAMPLE> input(kReadBackChunk, (DSP_SAMPLE)0.0);
+    input[0] = (DSP_SAMPLE)1.0;
+    DSP_SAMPLE* inputPointer = input.data();
+    while (taps.size() < maxLength)
+    {
+      DSP_SAMPLE** output = ir.Process(&inputPointer, 1, kReadBackChunk);
+      input[0] = (DSP_SAMPLE)0.0;
+      taps.insert(taps.end(), output[0], output[0] + kReadBackChunk);
+    }
+    while (!taps.empty() && taps.back() == 0.0f)
+      taps.pop_back();
+    return taps;
+  };
+
+  dsp::wav::LoadReturnCode mWavState = dsp::wav::LoadReturnCode::SUCCESS;
+  dsp::ImpulseResponse::IRData mData;
+  dsp::IRProcessing mProcessing;
+  mutable std::mutex mMutex;
+  // By sample rate
+  std::map<double, Variant> mVariants;
+};
@@ -0,0 +1,123 @@
+#pragma once
+
+// One IRSource per IR file, shared by every plugin instance in the process.
+// A session with the same cab IR on 30 tracks reads, resamples, processes, and transforms it once (per sample rate
+// and block size) instead of 30 times. Each instance still has its own ConvolutionIR for the convolution state.
+//
+// Sources are found by the file's canonical path and a hash of its contents (so that a file that was changed on disk
+// is read again) along with the IRProcessing they were made with. The store only keeps weak references: a source
+// goes away with the last ConvolutionIR that uses it.
+
+#include <cstdint>
+#include <filesystem>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <tuple>
+
+#include "../AudioDSPTools/dsp/wav.h"
+
+#include "FileHash.h"
+#include "IRProcessing.h"
+#include "IRSource.h"
+
+class IRStore
+{
+public:
+  static IRStore& Get()
+  {
+    static IRStore store;
+    return store;
+  };
+
+  // Not on the audio thread.
+  // Gets the taps at sampleRate ready if it has to read the file. Check wavState; it's null on failure.
+  std::shared_ptr<IRSource> Load(const std::filesystem::path& path, const double sampleRate,
+                                 const dsp::IRProcessing& processing, dsp::wav::LoadReturnCode& wavState)
+  {
+    Key key;
+    const bool hashed = _MakeKey(path, processing, key);
+    if (hashed)
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      if (std::shared_ptr<IRSource> source = _Find(key))
+      {
+        wavState = source->GetWavState();
+        return source;
+      }
+    }
+
+    // Not under the lock; reading and resampling can take a while. If another instance reads the same file at the
+    // same time, then whichever gets here second uses the first one's.
+    auto source = std::make_shared<IRSource>(path.string().c_str(), sampleRate, processing);
+    wavState = source->GetWavState();
+    if (wavState != dsp::wav::LoadReturnCode::SUCCESS)
+      return nullptr;
+    if (!hashed)
+      return source;
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (std::shared_ptr<IRSource> existing = _Find(key))
+      return existing;
+    _Prune();
+    mSources[key] = source;
+    return source;
+  };
+
+  // How many sources are in use
+  size_t GetNumSources() const
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    size_t numSources = 0;
+    for (const auto& entry : mSources)
+      if (!entry.second.expired())
+        numSources++;
+    return numSources;
+  };
+
+private:
+  struct Key
+  {
+    std::filesystem::path path;
+    uint64_t hash = 0;
+    dsp::IRProcessing processing;
+
+    bool operator<(const Key& other) const
+    {
+      return std::tie(path, hash, processing.trim, processing.trimThreshold, processing.minimumPhase)
+             < std::tie(other.path, other.hash, other.processing.trim, other.processing.trimThreshold,
+                        other.processing.minimumPhase);
+    };
+  };
+
+  IRStore() = default;
+
+  // Returns false if the file can't be read, in which case it's not shared.
+  static bool _MakeKey(const std::filesystem::path& path, const dsp::IRProcessing& processing, Key& key)
+  {
+    std::error_code error;
+    const std::filesystem::path canonical = std::filesystem::weakly_canonical(path, error);
+    key.path = error ? path : canonical;
+    key.processing = processing;
+    key.hash = kFileHashSeed;
+    return HashFile(path, key.hash);
+  };
+
+  // Call with mMutex locked.
+  std::shared_ptr<IRSource> _Find(const Key& key) const
+  {
+    auto it = mSources.find(key);
+    return it != mSources.end() ? it->second.lock() : nullptr;
+  };
+  // Call with mMutex locked.
+  // Forgets the sources that nobody uses anymore.
+  void _Prune()
+  {
+    for (auto it = mSources.begin(); it != mSources.end();)
+      it = it->second.expired() ? mSources.erase(it) : std::next(it);
+  };
+
+  mutable std::mutex mMutex;
+  std::map<Key, std::weak_ptr<IRSource>> mSources;
+};
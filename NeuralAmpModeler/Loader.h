@@ -0,0 +1,473 @@
+#pragma once
+
+// Loads models and IRs on the WorkerPool so that the UI and session recall don't wait on parsing, building,
+// prewarming, or resampling.
+//
+// * Load() queues a job. A newer job for the same kind (model or IR) cancels the older one, whether it's still
+//   queued or half-way done.
+// * Finished modules go straight into their DSPStaging slot, ready for the settings (sample rate, etc.) current at
+//   that moment.
+// * How it went is collected on the main thread with PopResult().
+// * Resample() makes the IR that's in use again at a new sample rate or block size. It's quietly dropped if another IR
+//   comes along first.
+
+#include <array>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "../AudioDSPTools/dsp/wav.h"
+#include "../NeuralAmpModelerCore/NAM/get_dsp.h"
+
+#include "ConvolutionIR.h"
+#include "IRProcessing.h"
+#include "IRSource.h"
+#include "IRStore.h"
+#include "ModelStore.h"
+#include "ResamplingNAM.h"
+#include "Staging.h"
+#include "WorkerPool.h"
+
+class BackgroundLoader : public WorkerPool::Client
+{
+public:
+  enum class Kind
+  {
+    Model = 0,
+    IR,
+    NumKinds
+  };
+
+  // What loaded modules need to be ready for
+  struct Settings
+  {
+    double sampleRate = 48000.0;
+    int maxBlockSize = 64;
+    double slim = 0.0;
+    // For IRs that get loaded from now on
+    dsp::IRProcessing irProcessing;
+  };
+
+  struct Result
+  {
+    Kind kind = Kind::Model;
+    std::string path;
+    // Whether it came from the user (file browser) instead of e.g. session recall
+    bool fromUser = false;
+    bool success = false;
+    // On failure, the last path of this kind that did load (possibly empty)
+    std::string previousPath;
+    std::string errorMessage;
+    // IRs only
+    dsp::wav::LoadReturnCode wavState = dsp::wav::LoadReturnCode::SUCCESS;
+    // Taps after and before the IRProcessing, at the sample rate it was loaded at
+    size_t irLength = 0;
+    size_t irUnprocessedLength = 0;
+  };
+
+  BackgroundLoader(DSPStaging<ResamplingNAM>& stagedModel, DSPStaging<ConvolutionIR>& stagedIR)
+  : mStagedModel(stagedModel)
+  , mStagedIR(stagedIR)
+  {
+  }
+  BackgroundLoader(const BackgroundLoader&) = delete;
+  BackgroundLoader& operator=(const BackgroundLoader&) = delete;
+  ~BackgroundLoader()
+  {
+    {
+      // Whatever is queued is dropped; only the job that's under way (if any) is finished.
+      std::lock_guard<std::mutex> lock(mMutex);
+      mStop = true;
+    }
+    Detach();
+  };
+
+  // Not on the audio thread.
+  void Load(const Kind kind, const std::string& path, const bool fromUser)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      Job job;
+      job.kind = kind;
+      job.path = path;
+      job.fromUser = fromUser;
+      job.generation = ++mGenerations[_Index(kind)];
+      mJobs.push_back(std::move(job));
+      mPending[_Index(kind)]++;
+    }
+    Wake();
+  };
+
+  // Not on the audio thread.
+  // Makes an IR from source at the current settings and stages it, unless another IR is already on its way or gets
+  // staged first. Doesn't report anything.
+  void Resample(std::shared_ptr<IRSource> source)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      if (mPending[_Index(Kind::IR)] > 0 || mStagedIR.HasStaged())
+        return;
+      _QueueResample(std::move(source));
+    }
+    Wake();
+  };
+
+  // Not on the audio thread.
+  // Drops anything of this kind that's on its way, and forgets what was loaded last.
+  // Doesn't report anything; whoever cancels knows.
+  void Cancel(const Kind kind)
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    ++mGenerations[_Index(kind)];
+    mLoadedPaths[_Index(kind)].clear();
+  };
+
+  bool IsLoading(const Kind kind) const
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mPending[_Index(kind)] > 0;
+  };
+
+  // Not on the audio thread.
+  // Also brings whatever is already staged up to date so that nothing stale reaches the audio thread. A staged IR at
+  // another sample rate or block size is taken back and made again in the background.
+  void Reset(const double sampleRate, const int maxBlockSize)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mSettings.sampleRate = sampleRate;
+      mSettings.maxBlockSize = maxBlockSize;
+      if (std::unique_ptr<ResamplingNAM> stagedModel = mStagedModel.Unstage())
+      {
+        stagedModel->Reset(sampleRate, maxBlockSize);
+        mStagedModel.Restage(std::move(stagedModel));
+      }
+      if (std::unique_ptr<ConvolutionIR> stagedIR = mStagedIR.Unstage())
+      {
+        if (stagedIR->GetSampleRate() == sampleRate && stagedIR->GetMaxBlockSize() == maxBlockSize)
+          mStagedIR.Restage(std::move(stagedIR));
+        else
+          _QueueResample(stagedIR->GetSource());
+      }
+    }
+    Wake();
+  };
+
+  // Not on the audio thread.
+  // Applies to IRs loaded from now on. Load the IR again for it to apply to that one.
+  void SetIRProcessing(const dsp::IRProcessing& processing)
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mSettings.irProcessing = processing;
+  };
+
+  // Not on the audio thread.
+  // Applies to what's staged as well as to what will be.
+  void SetSlim(const double slim)
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mSettings.slim = slim;
+    _ApplySlim(mStagedModel.Peek(), slim);
+  };
+
+  // Main thread.
+  // Returns false if there's nothing new.
+  bool PopResult(Result& result)
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mResults.empty())
+      return false;
+    result = std::move(mResults.front());
+    mResults.pop_front();
+    return true;
+  };
+
+  // Builds a model the way the plugin wants it: 1 input and 1 output channel, resampled, and prewarmed.
+  // The config comes from the ModelStore, so instances with the same model only parse it once.
+  // Throws on failure.
+  static std::unique_ptr<ResamplingNAM> BuildModel(const std::string& modelPath, const double sampleRate,
+                                                   const int maxBlockSize, const double slim)
+  {
+    auto dspPath = std::filesystem::u8path(modelPath);
+    std::unique_ptr<nam::DSP> model;
+    std::shared_ptr<const ModelSource> source = ModelStore::Get().Load(dspPath, model);
+
+    // Check that the model has 1 input and 1 output channel
+    if (model->NumInputChannels() != 1)
+    {
+      throw std::runtime_error("Model must have 1 input channel, but has " + std::to_string(model->NumInputChannels()));
+    }
+    if (model->NumOutputChannels() != 1)
+    {
+      throw std::runtime_error("Model must have 1 output channel, but has "
+                               + std::to_string(model->NumOutputChannels()));
+    }
+
+    std::unique_ptr<ResamplingNAM> temp = std::make_unique<ResamplingNAM>(std::move(model), sampleRate);
+    temp->SetTailLength(GetModelTailLength(source->GetHeader()));
+    temp->SetSource(std::move(source));
+    temp->Reset(sampleRate, maxBlockSize);
+    _ApplySlim(temp.get(), slim);
+    return temp;
+  };
+
+  // How long a model keeps going after its input stops (seconds), from its config:
+  // * Convolutional ones (WaveNet, ConvNet, Linear) go for as long as their receptive field.
+  // * Recurrent ones (LSTM) never quite stop; this is about how long they take to settle.
+  // * Anything else is guessed the same way as the recurrent ones.
+  static double GetModelTailLength(const nam::dspData& config)
+  {
+    const double sampleRate = config.expected_sample_rate > 0.0 ? config.expected_sample_rate : 48000.0;
+    long receptiveField = 0;
+    try
+    {
+      const nlohmann::json& c = config.config;
+      if (c.contains("layers")) // WaveNet
+      {
+        receptiveField = 1;
+        for (const auto& layer : c["layers"])
+        {
+          const long kernelSize = layer["kernel_size"].get<long>();
+          for (const auto& dilation : layer["dilations"])
+            receptiveField += (kernelSize - 1) * dilation.get<long>();
+        }
+      }
+      else if (c.contains("dilations")) // ConvNet: kernels of 2
+      {
+        receptiveField = 1;
+        for (const auto& dilation : c["dilations"])
+          receptiveField += dilation.get<long>();
+      }
+      else if (c.contains("receptive_field")) // Linear
+        receptiveField = c["receptive_field"].get<long>();
+    }
+    catch (std::exception&)
+    {
+      receptiveField = 0;
+    }
+    return receptiveField > 0 ? (double)receptiveField / sampleRate : kRecurrentModelTailLength;
+  };
+
+  // Loads and resamples an IR, or finds it in the IRStore if another instance already has it. Check wavState before
+  // using it (it's null on failure).
+  static std::unique_ptr<ConvolutionIR> BuildIR(const std::string& irPath, const double sampleRate,
+                                                const int maxBlockSize, const dsp::IRProcessing& processing,
+                                                dsp::wav::LoadReturnCode& wavState)
+  {
+    auto irPathU8 = std::filesystem::u8path(irPath);
+    std::shared_ptr<IRSource> source = IRStore::Get().Load(irPathU8, sampleRate, processing, wavState);
+    if (wavState != dsp::wav::LoadReturnCode::SUCCESS)
+      return nullptr;
+    return std::make_unique<ConvolutionIR>(std::move(source), sampleRate, maxBlockSize);
+  };
+
+private:
+  // Seconds. What NeuralAmpModelerCore prewarms its LSTMs for.
+  static constexpr double kRecurrentModelTailLength = 0.5;
+
+  struct Job
+  {
+    Kind kind = Kind::Model;
+    std::string path;
+    bool fromUser = false;
+    size_t generation = 0;
+    // Resampling jobs only: the IR to make again, and how many IRs had been staged when it was queued
+    std::shared_ptr<IRSource> resample;
+    size_t numStagedIRs = 0;
+  };
+
+  static size_t _Index(const Kind kind) { return (size_t)kind; };
+
+  static void _ApplySlim(ResamplingNAM* model, const double slim)
+  {
+    if (model == nullptr)
+      return;
+    if (nam::SlimmableModel* slimmable = model->GetSlimmableModel())
+      slimmable->SetSlimmableSize(slim);
+  };
+
+  // Call with mMutex locked.
+  // Shares the IR generation, so that loading or clearing an IR cancels it.
+  void _QueueResample(std::shared_ptr<IRSource> source)
+  {
+    Job job;
+    job.kind = Kind::IR;
+    job.generation = mGenerations[_Index(Kind::IR)];
+    job.resample = std::move(source);
+    job.numStagedIRs = mNumStagedIRs;
+    mJobs.push_back(std::move(job));
+  };
+
+  // These are called with mMutex unlocked.
+  void _LoadModel(const Job& job, Settings settings, Result& result)
+  {
+    std::unique_ptr<ResamplingNAM> model;
+    try
+    {
+      model = BuildModel(job.path, settings.sampleRate, settings.maxBlockSize, settings.slim);
+    }
+    catch (std::exception& e)
+    {
+      result.errorMessage = e.what();
+      return;
+    }
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    // If the settings changed while we were busy, then catch up before staging.
+    while (!_IsCancelled(job)
+           && (mSettings.sampleRate != settings.sampleRate || mSettings.maxBlockSize != settings.maxBlockSize))
+    {
+      settings = mSettings;
+      lock.unlock();
+      model->Reset(settings.sampleRate, settings.maxBlockSize);
+      lock.lock();
+    }
+    if (_IsCancelled(job))
+      return;
+    _ApplySlim(model.get(), mSettings.slim);
+    mStagedModel.Stage(std::move(model));
+    result.success = true;
+  };
+
+  void _LoadIR(const Job& job, Settings settings, Result& result)
+  {
+    std::unique_ptr<ConvolutionIR> ir;
+    try
+    {
+      ir = BuildIR(job.path, settings.sampleRate, settings.maxBlockSize, settings.irProcessing, result.wavState);
+    }
+    catch (std::exception& e)
+    {
+      result.wavState = dsp::wav::LoadReturnCode::ERROR_OTHER;
+      result.errorMessage = e.what();
+      return;
+    }
+    if (result.wavState != dsp::wav::LoadReturnCode::SUCCESS)
+    {
+      result.errorMessage = dsp::wav::GetMsgForLoadReturnCode(result.wavState);
+      return;
+    }
+    result.irLength = ir->GetLength();
+    result.irUnprocessedLength = ir->GetSource()->GetUnprocessedLength(settings.sampleRate);
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    _CatchUp(job, settings, ir, lock);
+    if (_IsCancelled(job))
+      return;
+    mStagedIR.Stage(std::move(ir));
+    mNumStagedIRs++;
+    result.success = true;
+  };
+
+  void _ResampleIR(const Job& job, Settings settings)
+  {
+    std::unique_ptr<ConvolutionIR> ir;
+    try
+    {
+      ir = std::make_unique<ConvolutionIR>(job.resample, settings.sampleRate, settings.maxBlockSize);
+    }
+    catch (std::exception&)
+    {
+      // Keep going at the old sample rate.
+      return;
+    }
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    _CatchUp(job, settings, ir, lock);
+    // Anything staged since is newer, even if the audio thread has already taken it.
+    if (_IsCancelled(job) || mNumStagedIRs != job.numStagedIRs)
+      return;
+    mStagedIR.Restage(std::move(ir));
+    mNumStagedIRs++;
+  };
+
+  // If the sample rate or block size changed while we were busy, then make the IR again for the new ones.
+  void _CatchUp(const Job& job, Settings& settings, std::unique_ptr<ConvolutionIR>& ir,
+                std::unique_lock<std::mutex>& lock)
+  {
+    while (!_IsCancelled(job)
+           && (mSettings.sampleRate != settings.sampleRate || mSettings.maxBlockSize != settings.maxBlockSize))
+    {
+      settings = mSettings;
+      lock.unlock();
+      ir = std::make_unique<ConvolutionIR>(ir->GetSource(), settings.sampleRate, settings.maxBlockSize);
+      lock.lock();
+    }
+  };
+
+  // Call with mMutex locked.
+  bool _IsCancelled(const Job& job) const { return job.generation != mGenerations[_Index(job.kind)]; };
+
+  // Until there aren't any jobs left
+  void Work() override
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (!mStop && !mJobs.empty())
+    {
+      const Job job = std::move(mJobs.front());
+      mJobs.pop_front();
+      if (job.resample != nullptr)
+      {
+        if (!_IsCancelled(job))
+        {
+          const Settings settings = mSettings;
+          lock.unlock();
+          _ResampleIR(job, settings);
+          lock.lock();
+        }
+        continue;
+      }
+      if (!_IsCancelled(job))
+      {
+        const Settings settings = mSettings;
+        Result result;
+        result.kind = job.kind;
+        result.path = job.path;
+        result.fromUser = job.fromUser;
+
+        lock.unlock();
+        if (job.kind == Kind::Model)
+          _LoadModel(job, settings, result);
+        else
+          _LoadIR(job, settings, result);
+        lock.lock();
+
+        // Cancelled ones don't report anything.
+        if (!_IsCancelled(job))
+        {
+          std::string& loadedPath = mLoadedPaths[_Index(job.kind)];
+          if (result.success)
+            loadedPath = job.path;
+          else
+            result.previousPath = loadedPath;
+          mResults.push_back(std::move(result));
+        }
+      }
+      mPending[_Index(job.kind)]--;
+    }
+  };
+
+  static constexpr size_t kNumKinds = (size_t)Kind::NumKinds;
+
+  DSPStaging<ResamplingNAM>& mStagedModel;
+  DSPStaging<ConvolutionIR>& mStagedIR;
+
+  // Guards everything below
+  mutable std::mutex mMutex;
+  Settings mSettings;
+  std::deque<Job> mJobs;
+  std::deque<Result> mResults;
+  // Bumped by every new job and cancellation. A job whose generation is behind is cancelled.
+  std::array<size_t, kNumKinds> mGenerations{};
+  // Jobs that were queued and haven't been dealt with yet (not counting resampling)
+  std::array<int, kNumKinds> mPending{};
+  // IRs staged, ever. A resampling job that sees it move on has been overtaken.
+  size_t mNumStagedIRs = 0;
+  std::array<std::string, kNumKinds> mLoadedPaths;
+  bool mStop = false;
+};
@@ -0,0 +1,114 @@
+#pragma once
+
+// A file mapped into memory, read-only, for as long as this is around.
+// Reading from it is reading the file: the OS pages it in as it's touched, and nothing is copied until the caller
+// does so.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+
+#if defined(_WIN32)
+  #ifndef NOMINMAX
+    #define NOMINMAX
+  #endif
+  #ifndef WIN32_LEAN_AND_MEAN
+    #define WIN32_LEAN_AND_MEAN
+  #endif
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+// For reading numbers out of a mapped file in a given byte order
+inline bool IsLittleEndian()
+{
+  const uint16_t one = 1;
+  uint8_t firstByte;
+  std::memcpy(&firstByte, &one, 1);
+  return firstByte == 1;
+}
+
+class MappedFile
+{
+public:
+  // Throws on failure.
+  explicit MappedFile(const std::filesystem::path& path)
+  {
+#if defined(_WIN32)
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+      throw std::runtime_error("Can't open " + path.string());
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size))
+    {
+      CloseHandle(file);
+      throw std::runtime_error("Can't get the size of " + path.string());
+    }
+    mSize = (size_t)size.QuadPart;
+    if (mSize > 0)
+    {
+      HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+      if (mapping != nullptr)
+      {
+        mData = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        // The view keeps what it needs.
+        CloseHandle(mapping);
+      }
+    }
+    CloseHandle(file);
+#else
+    const int file = open(path.c_str(), O_RDONLY);
+    if (file < 0)
+      throw std::runtime_error("Can't open " + path.string());
+    struct stat status;
+    if (fstat(file, &status) != 0)
+    {
+      close(file);
+      throw std::runtime_error("Can't get the size of " + path.string());
+    }
+    mSize = (size_t)status.st_size;
+    if (mSize > 0)
+    {
+      void* data = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, file, 0);
+      if (data != MAP_FAILED)
+      {
+        mData = data;
+        // It's read front to back.
+        madvise(mData, mSize, MADV_SEQUENTIAL);
+      }
+    }
+    // The mapping keeps what it needs.
+    close(file);
+#endif
+    if (mSize > 0 && mData == nullptr)
+      throw std::runtime_error("Can't map " + path.string());
+  };
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  ~MappedFile()
+  {
+    if (mData == nullptr)
+      return;
+#if defined(_WIN32)
+    UnmapViewOfFile(mData);
+#else
+    munmap(mData, mSize);
+#endif
+  };
+
+  const uint8_t* GetData() const { return (const uint8_t*)mData; };
+  // Bytes
+  size_t GetSize() const { return mSize; };
+
+private:
+  void* mData = nullptr;
+  size_t mSize = 0;
+};
@@ -0,0 +1,135 @@
+#pragma once
+
+// What's read from a model file, apart from its weights: version, architecture, config, and metadata.
+// It doesn't change once it's made, so plugin instances with the same model share one (see ModelStore.h). Each
+// instance builds its own nam::DSP, which has the layers (with their own copy of the weights, since
+// NeuralAmpModelerCore's layers keep one) and the buffers and history that processing needs.
+// The weights aren't kept here. That would be one more copy of them next to the models' own; instead, each build
+// reads them from the file again. That's a copy out of a mapped file for .namb and weights.npy, and only parsing the
+// numbers (not the rest of the file) for .nam.
+
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "../NeuralAmpModelerCore/NAM/dsp.h"
+#include "../NeuralAmpModelerCore/NAM/get_dsp.h"
+
+#include "BinaryModel.h"
+#include "NamFile.h"
+#include "NpyFile.h"
+
+class ModelSource
+{
+public:
+  // Reads a .nam file (see NamFile.h), a .namb file (see BinaryModel.h), or a config.json + weights.npy directory.
+  // Throws on failure.
+  // :param model: Gets the model that's built along the way, so the first one doesn't have to be built again.
+  ModelSource(const std::filesystem::path& path, std::unique_ptr<nam::DSP>& model)
+  {
+    const auto start = std::chrono::steady_clock::now();
+    _ReadHeader(path, mHeader);
+    mReadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    mSize = _GetSize(mHeader);
+
+    nam::dspData data = mHeader;
+    _ReadWeights(path, data.weights);
+    mNumWeights = data.weights.size();
+    model = nam::get_dsp(data);
+  };
+  ModelSource(const ModelSource&) = delete;
+  ModelSource& operator=(const ModelSource&) = delete;
+
+  // Everything that get_dsp() would read, weights included. Throws on failure.
+  static void Read(const std::filesystem::path& path, nam::dspData& data)
+  {
+    std::error_code error;
+    if (binary_model::IsBinaryModel(path))
+      binary_model::Read(path, data);
+    else if (std::filesystem::is_directory(path, error))
+    {
+      _ReadDirectoryHeader(path, data);
+      npy::ReadWeights(path / "weights.npy", data.weights);
+    }
+    else
+      nam_file::Read(path, data);
+  };
+
+  // Everything but the weights (which are left empty)
+  const nam::dspData& GetHeader() const { return mHeader; };
+  size_t GetNumWeights() const { return mNumWeights; };
+  // Bytes, of the weights that each model built from this reads
+  size_t GetWeightsSize() const { return mNumWeights * sizeof(float); };
+  // Bytes, roughly: the config and metadata as text
+  size_t GetSize() const { return mSize; };
+  // How long reading and parsing everything but the weights took. That's what a model built from this instead of
+  // from the file doesn't have to do again.
+  double GetReadSeconds() const { return mReadSeconds; };
+
+  // A new model, with nothing in common with any other. Throws on failure.
+  // :param path: Where to read the weights from: the model this was read from, or one with the same contents.
+  std::unique_ptr<nam::DSP> Build(const std::filesystem::path& path) const
+  {
+    // get_dsp() takes the config by reference and doesn't promise to leave it alone, so it gets a copy (like
+    // NeuralAmpModelerCore does for itself when it reads a file). Without the weights, that's small.
+    nam::dspData data = mHeader;
+    _ReadWeights(path, data.weights);
+    if (data.weights.size() != mNumWeights)
+      throw std::runtime_error(path.string() + " changed since it was read");
+    return nam::get_dsp(data);
+  };
+
+private:
+  static void _ReadHeader(const std::filesystem::path& path, nam::dspData& data)
+  {
+    std::error_code error;
+    if (binary_model::IsBinaryModel(path))
+      binary_model::ReadHeader(path, data);
+    else if (std::filesystem::is_directory(path, error))
+      _ReadDirectoryHeader(path, data);
+    else
+      nam_file::ReadHeader(path, data);
+  };
+  // weights.npy is mapped and checked instead of going through get_dsp()'s reader (see NpyFile.h).
+  static void _ReadWeights(const std::filesystem::path& path, std::vector<float>& weights)
+  {
+    std::error_code error;
+    if (binary_model::IsBinaryModel(path))
+      binary_model::ReadWeights(path, weights);
+    else if (std::filesystem::is_directory(path, error))
+      npy::ReadWeights(path / "weights.npy", weights);
+    else
+      nam_file::ReadWeights(path, weights);
+  };
+  static void _ReadDirectoryHeader(const std::filesystem::path& path, nam::dspData& data)
+  {
+    const std::filesystem::path configPath = path / "config.json";
+    std::ifstream in(configPath);
+    if (!in)
+      throw std::runtime_error("Can't open " + configPath.string());
+    nlohmann::json j;
+    in >> j;
+    data.version = j.at("version").get<std::string>();
+    data.architecture = j.at("architecture").get<std::string>();
+    data.config = j.at("config");
+    data.metadata = j.value("metadata", nlohmann::json());
+    data.expected_sample_rate = j.value("sample_rate", -1.0);
+  };
+
+  static size_t _GetSize(const nam::dspData& data)
+  {
+    return sizeof(nam::dspData) + data.version.size() + data.architecture.size() + data.config.dump().size()
+           + data.metadata.dump().size();
+  };
+
+  nam::dspData mHeader;
+  size_t mNumWeights = 0;
+  size_t mSize = 0;
+  double mReadSeconds = 0.0;
+};
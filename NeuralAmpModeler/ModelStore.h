@@ -0,0 +1,282 @@
+#pragma once
+
+// One ModelSource per model, shared by every plugin instance in the process.
+// A session with the same model on 24 tracks parses its config and metadata once; the other instances only read the
+// weights to build their nam::DSP. The weights themselves aren't shared: NeuralAmpModelerCore's layers each keep their
+// own copy, and the source doesn't keep one (see ModelSource.h), so each instance has one copy of them.
+//
+// Sources are found by a hash of the model's contents along with their size, wherever it is (a .nam file, or
+// config.json and weights.npy for a directory). The hash isn't cryptographic, so the size is there to make mixing up
+// two different models even less likely. Working out the hash means reading the files, so a model that was loaded
+// before is first looked for by its canonical path and the times and sizes of its files: if none of them changed,
+// it's not read at all.
+//
+// Besides the sources that are in use, the store keeps the ones that were used most recently, up to a memory limit,
+// so that reopening a project or duplicating a track doesn't parse again what was just let go.
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <iterator>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <tuple>
+
+#include "../NeuralAmpModelerCore/NAM/dsp.h"
+
+#include "FileHash.h"
+#include "ModelSource.h"
+
+// Bytes
+const size_t kDefaultModelCacheLimit = 64 << 20;
+
+class ModelStore
+{
+public:
+  struct Stats
+  {
+    // Loads that found what they wanted already parsed
+    size_t hits = 0;
+    // Loads that had to parse the model
+    size_t misses = 0;
+    // What the hits would have spent reading and parsing everything but the weights (see
+    // ModelSource::GetReadSeconds()). They still read the weights and build their models, so that's not in here.
+    double secondsSaved = 0.0;
+    // Of the recently used sources that are kept around
+    size_t cacheSize = 0;
+    size_t cacheLimit = 0;
+  };
+
+  static ModelStore& Get()
+  {
+    static ModelStore store;
+    return store;
+  };
+
+  // Not on the audio thread. Throws on failure.
+  // :param model: Gets a new model built from what's returned.
+  std::shared_ptr<const ModelSource> Load(const std::filesystem::path& path, std::unique_ptr<nam::DSP>& model)
+  {
+    const Key key = _MakeKey(path);
+    std::shared_ptr<const ModelSource> source;
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      auto it = mHashes.find(key);
+      if (it != mHashes.end())
+        source = _Find(it->second);
+    }
+    Contents contents;
+    bool hashed = false;
+    if (source == nullptr)
+    {
+      // Same contents somewhere else, or files that were touched but not changed
+      hashed = _Hash(path, contents);
+      if (hashed)
+      {
+        std::lock_guard<std::mutex> lock(mMutex);
+        source = _Find(contents);
+        if (source != nullptr)
+          mHashes[key] = contents;
+      }
+    }
+    if (source != nullptr)
+    {
+      model = source->Build(path);
+      std::lock_guard<std::mutex> lock(mMutex);
+      _Hit(source);
+      return source;
+    }
+
+    // Not under the lock; parsing can take a while. If another instance reads the same model at the same time, then
+    // whichever gets here second shares the first one's.
+    source = std::make_shared<const ModelSource>(path, model);
+    std::lock_guard<std::mutex> lock(mMutex);
+    mStats.misses++;
+    if (!hashed)
+      return source;
+    if (std::shared_ptr<const ModelSource> existing = _Find(contents))
+      return existing;
+    _Prune();
+    mSources[contents] = source;
+    mHashes[key] = contents;
+    _KeepRecent(source);
+    return source;
+  };
+
+  // How many sources are in use, including the recent ones that are kept around
+  size_t GetNumSources() const
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    size_t numSources = 0;
+    for (const auto& entry : mSources)
+      if (!entry.second.expired())
+        numSources++;
+    return numSources;
+  };
+
+  Stats GetStats() const
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    Stats stats = mStats;
+    stats.cacheSize = mRecentSize;
+    stats.cacheLimit = mRecentLimit;
+    return stats;
+  };
+
+  // Bytes of recently used sources to keep around once nobody uses them. 0 to only share the ones in use.
+  void SetCacheLimit(const size_t limit)
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mRecentLimit = limit;
+    _Evict();
+  };
+
+  // Lets go of the recently used sources (the ones in use stay shared).
+  void ClearCache()
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mRecent.clear();
+    mRecentSize = 0;
+    _Prune();
+  };
+
+private:
+  // Where a model is and what its files look like on disk
+  struct Key
+  {
+    std::filesystem::path path;
+    // Of the files' times and sizes
+    uint64_t stamp = 0;
+
+    bool operator<(const Key& other) const { return std::tie(path, stamp) < std::tie(other.path, other.stamp); };
+  };
+  // What a model's files have in them
+  struct Contents
+  {
+    uint64_t hash = kFileHashSeed;
+    // Bytes, of all of the files
+    uint64_t size = 0;
+
+    bool operator<(const Contents& other) const { return std::tie(hash, size) < std::tie(other.hash, other.size); };
+  };
+
+  ModelStore() = default;
+
+  static Key _MakeKey(const std::filesystem::path& path)
+  {
+    Key key;
+    std::error_code error;
+    const std::filesystem::path canonical = std::filesystem::weakly_canonical(path, error);
+    key.path = error ? path : canonical;
+    key.stamp = kFileHashSeed;
+    if (std::filesystem::is_directory(path, error))
+    {
+      _Stamp(path / "config.json", key.stamp);
+      _Stamp(path / "weights.npy", key.stamp);
+    }
+    else
+      _Stamp(path, key.stamp);
+    return key;
+  };
+
+  // Folds the file's time and size into stamp (FNV-1a, like HashFile()).
+  static void _Stamp(const std::filesystem::path& path, uint64_t& stamp)
+  {
+    std::error_code error;
+    const uint64_t time = (uint64_t)std::filesystem::last_write_time(path, error).time_since_epoch().count();
+    const uint64_t size = error ? 0 : (uint64_t)std::filesystem::file_size(path, error);
+    for (const uint64_t value : {time, size})
+    {
+      for (int i = 0; i < 8; i++)
+      {
+        stamp ^= (value >> (8 * i)) & 0xff;
+        stamp *= 1099511628211ull;
+      }
+    }
+  };
+
+  // Returns false if the model can't be read, in which case it's not shared.
+  static bool _Hash(const std::filesystem::path& path, Contents& contents)
+  {
+    std::error_code error;
+    if (!std::filesystem::is_directory(path, error))
+      return _HashFile(path, contents);
+    // If weights.npy is missing, get_dsp() will say so.
+    if (!_HashFile(path / "config.json", contents))
+      return false;
+    _HashFile(path / "weights.npy", contents);
+    return true;
+  };
+  static bool _HashFile(const std::filesystem::path& path, Contents& contents)
+  {
+    if (!HashFile(path, contents.hash))
+      return false;
+    std::error_code error;
+    const uintmax_t size = std::filesystem::file_size(path, error);
+    if (!error)
+      contents.size += (uint64_t)size;
+    return true;
+  };
+
+  // Call with mMutex locked.
+  std::shared_ptr<const ModelSource> _Find(const Contents& contents) const
+  {
+    auto it = mSources.find(contents);
+    return it != mSources.end() ? it->second.lock() : nullptr;
+  };
+  // Call with mMutex locked.
+  void _Hit(const std::shared_ptr<const ModelSource>& source)
+  {
+    mStats.hits++;
+    mStats.secondsSaved += source->GetReadSeconds();
+    _KeepRecent(source);
+  };
+  // Call with mMutex locked.
+  // Puts the source first among the recent ones.
+  void _KeepRecent(const std::shared_ptr<const ModelSource>& source)
+  {
+    for (auto it = mRecent.begin(); it != mRecent.end(); ++it)
+    {
+      if (*it == source)
+      {
+        mRecent.splice(mRecent.begin(), mRecent, it);
+        return;
+      }
+    }
+    mRecent.push_front(source);
+    mRecentSize += source->GetSize();
+    _Evict();
+  };
+  // Call with mMutex locked.
+  // Lets go of the least recently used sources until the rest fit.
+  void _Evict()
+  {
+    while (!mRecent.empty() && mRecentSize > mRecentLimit)
+    {
+      mRecentSize -= mRecent.back()->GetSize();
+      mRecent.pop_back();
+    }
+  };
+  // Call with mMutex locked.
+  // Forgets the sources that nobody uses anymore.
+  void _Prune()
+  {
+    for (auto it = mSources.begin(); it != mSources.end();)
+      it = it->second.expired() ? mSources.erase(it) : std::next(it);
+    for (auto it = mHashes.begin(); it != mHashes.end();)
+      it = mSources.count(it->second) == 0 ? mHashes.erase(it) : std::next(it);
+  };
+
+  mutable std::mutex mMutex;
+  std::map<Contents, std::weak_ptr<const ModelSource>> mSources;
+  // What was at each key when it was last read
+  std::map<Key, Contents> mHashes;
+  // Most recently used first
+  std::list<std::shared_ptr<const ModelSource>> mRecent;
+  size_t mRecentSize = 0;
+  size_t mRecentLimit = kDefaultModelCacheLimit;
+  Stats mStats;
+};
@@ -0,0 +1,337 @@
+#pragma once
+
+// Reading .nam files without building a JSON document of the whole thing.
+// The weights are most of a .nam file: tens of thousands of numbers, which nlohmann::json would make into as many
+// nodes (and parse with strtod()). Here, the file is mapped into memory and gone through once. The weights array is
+// counted, then parsed straight into the weights. Everything else (version, architecture, config, metadata,
+// sample_rate) is small, and each of those values is handed to nlohmann::json on its own.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../NeuralAmpModelerCore/NAM/get_dsp.h"
+
+#include "MappedFile.h"
+
+namespace nam_file
+{
+namespace detail
+{
+// Parses a JSON number as a float.
+// Up to 19 significant digits are kept, which is far more than a float has. If they come to at most 2^53 and the
+// power of 10 is one that a double holds exactly, the double is what strtod() would give. Otherwise it can be an ulp
+// off, which only changes the float in a near-tie.
+// Returns false if there's no number at p.
+inline bool ParseFloat(const char*& p, const char* end, float& value)
+{
+  static const double kPowersOf10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                       1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+  const int kMaxExactPower = 22;
+  const int kMaxDigits = 19;
+
+  const char* start = p;
+  const bool negative = p < end && *p == '-';
+  if (negative)
+    p++;
+  uint64_t mantissa = 0;
+  int numDigits = 0;
+  int exponent = 0;
+  bool any = false;
+  for (; p < end && *p >= '0' && *p <= '9'; p++)
+  {
+    any = true;
+    if (numDigits < kMaxDigits)
+    {
+      mantissa = 10 * mantissa + (uint64_t)(*p - '0');
+      if (mantissa > 0)
+        numDigits++;
+    }
+    else
+      exponent++;
+  }
+  if (p < end && *p == '.')
+  {
+    for (p++; p < end && *p >= '0' && *p <= '9'; p++)
+    {
+      any = true;
+      if (numDigits < kMaxDigits)
+      {
+        mantissa = 10 * mantissa + (uint64_t)(*p - '0');
+        exponent--;
+        if (mantissa > 0)
+          numDigits++;
+      }
+    }
+  }
+  if (!any)
+  {
+    p = start;
+    return false;
+  }
+  if (p < end && (*p == 'e' || *p == 'E'))
+  {
+    p++;
+    const bool negativeExponent = p < end && *p == '-';
+    if (p < end && (*p == '-' || *p == '+'))
+      p++;
+    int e = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; p++)
+      e = std::min(10 * e + (*p - '0'), 100000);
+    exponent += negativeExponent ? -e : e;
+  }
+
+  double x = (double)mantissa;
+  if (mantissa == 0)
+    x = 0.0;
+  else if (exponent >= 0 && exponent <= kMaxExactPower)
+    x *= kPowersOf10[exponent];
+  else if (exponent < 0 && exponent >= -kMaxExactPower)
+    x /= kPowersOf10[-exponent];
+  else
+    x *= std::pow(10.0, exponent);
+  value = (float)(negative ? -x : x);
+  return true;
+}
+
+class Scanner
+{
+public:
+  Scanner(const char* begin, const char* end, const std::filesystem::path& path)
+  : mPos(begin)
+  , mEnd(end)
+  , mPath(path)
+  {
+  }
+
+  bool AtEnd()
+  {
+    _SkipWhitespace();
+    return mPos >= mEnd;
+  };
+  // Returns whether it was there.
+  bool Skip(const char c)
+  {
+    _SkipWhitespace();
+    if (mPos < mEnd && *mPos == c)
+    {
+      mPos++;
+      return true;
+    }
+    return false;
+  };
+  void Expect(const char c)
+  {
+    if (!Skip(c))
+      _Fail(std::string("expected '") + c + "'");
+  };
+
+  std::string ReadString()
+  {
+    _SkipWhitespace();
+    const char* begin = mPos;
+    _SkipString();
+    // Escapes are rare enough in keys to leave to nlohmann::json.
+    if (std::find(begin, mPos, '\\') != mPos)
+      return nlohmann::json::parse(begin, mPos).get<std::string>();
+    return std::string(begin + 1, mPos - 1);
+  };
+
+  // Any value, as a JSON document of its own
+  nlohmann::json ReadValue()
+  {
+    _SkipWhitespace();
+    const char* begin = mPos;
+    _SkipValue();
+    return nlohmann::json::parse(begin, mPos);
+  };
+  // Any value, without parsing it
+  void SkipValue()
+  {
+    _SkipWhitespace();
+    _SkipValue();
+  };
+
+  // An array of numbers
+  void ReadFloats(std::vector<float>& values)
+  {
+    Expect('[');
+    // Counted first, so that there's only the one allocation
+    const char* close = (const char*)std::memchr(mPos, ']', mEnd - mPos);
+    if (close == nullptr)
+      _Fail("the weights don't end");
+    values.clear();
+    values.reserve((size_t)std::count(mPos, close, ',') + 1);
+    if (Skip(']'))
+      return;
+    do
+    {
+      _SkipWhitespace();
+      float value;
+      if (!ParseFloat(mPos, mEnd, value))
+        _Fail("expected a number");
+      values.push_back(value);
+    } while (Skip(','));
+    Expect(']');
+  };
+
+private:
+  void _SkipWhitespace()
+  {
+    while (mPos < mEnd && (*mPos == ' ' || *mPos == '\n' || *mPos == '\r' || *mPos == '\t'))
+      mPos++;
+  };
+  void _SkipString()
+  {
+    if (mPos >= mEnd || *mPos != '"')
+      _Fail("expected a string");
+    for (mPos++; mPos < mEnd && *mPos != '"'; mPos++)
+      if (*mPos == '\\')
+        mPos++;
+    if (mPos >= mEnd)
+      _Fail("a string doesn't end");
+    mPos++;
+  };
+  void _SkipValue()
+  {
+    if (mPos >= mEnd)
+      _Fail("expected a value");
+    if (*mPos == '"')
+    {
+      _SkipString();
+      return;
+    }
+    if (*mPos != '{' && *mPos != '[')
+    {
+      // A number, true, false, or null
+      while (mPos < mEnd && *mPos != ',' && *mPos != '}' && *mPos != ']' && *mPos != ' ' && *mPos != '\n'
+             && *mPos != '\r' && *mPos != '\t')
+        mPos++;
+      return;
+    }
+    int depth = 0;
+    while (mPos < mEnd)
+    {
+      const char c = *mPos;
+      if (c == '"')
+      {
+        _SkipString();
+        continue;
+      }
+      mPos++;
+      if (c == '{' || c == '[')
+        depth++;
+      else if ((c == '}' || c == ']') && --depth == 0)
+        return;
+    }
+    _Fail("an object or array doesn't end");
+  };
+  [[noreturn]] void _Fail(const std::string& what) const
+  {
+    throw std::runtime_error(mPath.string() + " isn't a valid model file: " + what);
+  };
+
+  const char* mPos;
+  const char* mEnd;
+  std::filesystem::path mPath;
+};
+
+// :param readWeights: If false, the weights are skipped over instead (and data.weights is left alone).
+inline void Read(const std::filesystem::path& path, nam::dspData& data, const bool readWeights)
+{
+  const MappedFile file(path);
+  const char* begin = (const char*)file.GetData();
+  detail::Scanner scanner(begin, begin + file.GetSize(), path);
+
+  bool hasVersion = false, hasArchitecture = false, hasConfig = false, hasWeights = false;
+  data.metadata = nlohmann::json();
+  data.expected_sample_rate = -1.0;
+  scanner.Expect('{');
+  if (!scanner.Skip('}'))
+  {
+    do
+    {
+      const std::string key = scanner.ReadString();
+      scanner.Expect(':');
+      if (key == "weights")
+      {
+        if (readWeights)
+          scanner.ReadFloats(data.weights);
+        else
+          scanner.SkipValue();
+        hasWeights = true;
+        continue;
+      }
+      const nlohmann::json value = scanner.ReadValue();
+      if (key == "version")
+      {
+        data.version = value.get<std::string>();
+        hasVersion = true;
+      }
+      else if (key == "architecture")
+      {
+        data.architecture = value.get<std::string>();
+        hasArchitecture = true;
+      }
+      else if (key == "config")
+      {
+        data.config = value;
+        hasConfig = true;
+      }
+      else if (key == "metadata")
+        data.metadata = value;
+      else if (key == "sample_rate" && value.is_number())
+        data.expected_sample_rate = value.get<double>();
+    } while (scanner.Skip(','));
+    scanner.Expect('}');
+  }
+  if (!scanner.AtEnd())
+    throw std::runtime_error(path.string() + " has something after the model");
+  if (!hasVersion || !hasArchitecture || !hasConfig)
+    throw std::runtime_error(path.string() + " is missing its version, architecture, or config");
+  if (!hasWeights)
+    throw std::runtime_error("Corrupted model file is missing weights.");
+}
+}; // namespace detail
+
+// What get_dsp() would read into data, without building the model. Throws on failure.
+inline void Read(const std::filesystem::path& path, nam::dspData& data)
+{
+  detail::Read(path, data, true);
+}
+
+// The same, but everything except the weights. Throws on failure.
+inline void ReadHeader(const std::filesystem::path& path, nam::dspData& data)
+{
+  detail::Read(path, data, false);
+}
+
+// Only the weights; the rest of the file is skipped over without being parsed. Throws on failure.
+inline void ReadWeights(const std::filesystem::path& path, std::vector<float>& weights)
+{
+  const MappedFile file(path);
+  const char* begin = (const char*)file.GetData();
+  detail::Scanner scanner(begin, begin + file.GetSize(), path);
+  scanner.Expect('{');
+  if (!scanner.Skip('}'))
+  {
+    do
+    {
+      const std::string key = scanner.ReadString();
+      scanner.Expect(':');
+      if (key == "weights")
+      {
+        scanner.ReadFloats(weights);
+        return;
+      }
+      scanner.SkipValue();
+    } while (scanner.Skip(','));
+  }
+  throw std::runtime_error("Corrupted model file is missing weights.");
+}
+}; // namespace nam_file
@@ -1,4 +1,5 @@
-#include <algorithm> // std::clamp, std::min
+#include <algorithm> // std::clamp, std::fill, std::min
+#include <chrono>
 #include <cmath> // pow
 #include <filesystem>
 #include <iostream>
@@ -14,14 +15,13 @@
 #include "IPlug_include_in_plug_src.h"
 // clang-format on
 #include "architecture.hpp"
+#include "RealtimeSanitizer.h"
 
 #include "NeuralAmpModelerControls.h"
 
 using namespace iplug;
 using namespace igraphics;
 
-const double kDCBlockerFrequency = 5.0;
-
 // Styles
 const IVColorSpec colorSpec{
   DEFAULT_BGCOLOR, // Background
@@ -73,12 +73,26 @@ const std::string kCalibrateInputParamName = "CalibrateInput";
 const bool kDefaultCalibrateInput = false;
 const std::string kInputCalibrationLevelParamName = "InputCalibrationLevel";
 const double kDefaultInputCalibrationLevel = 12.0;
+// Noise gate timing, in ms
+const std::string kNoiseGateAttackParamName = "GateAttack";
+const double kDefaultNoiseGateAttack = 1000.0 * kDefaultNoiseGateOpenTime;
+const std::string kNoiseGateHoldParamName = "GateHold";
+const double kDefaultNoiseGateHold = 1000.0 * kDefaultNoiseGateHoldTime;
+const std::string kNoiseGateReleaseParamName = "GateRelease";
+const double kDefaultNoiseGateRelease = 1000.0 * kDefaultNoiseGateCloseTime;
+// IR processing
+const std::string kIRTrimParamName = "IRTrim";
+const bool kDefaultIRTrim = false;
+const std::string kIRTrimThresholdParamName = "IRTrimThreshold";
+const std::string kIRMinimumPhaseParamName = "IRMinimumPhase";
+const bool kDefaultIRMinimumPhase = false;
+// How long the IR processing params have to stay put before the IR is loaded again with them
+const auto kIRProcessingSettleTime = std::chrono::milliseconds(300);
 
 
 NeuralAmpModeler::NeuralAmpModeler(const InstanceInfo& info)
 : Plugin(info, MakeConfig(kNumParams, kNumPresets))
 {
-  _InitToneStack();
   nam::activations::Activation::enable_fast_tanh();
   GetParam(kInputLevel)->InitGain("Input", 0.0, -20.0, 20.0, 0.1);
   GetParam(kToneBass)->InitDouble("Bass", 5.0, 0.0, 10.0, 0.1);
@@ -94,8 +108,15 @@ NeuralAmpModeler::NeuralAmpModeler(const InstanceInfo& info)
   GetParam(kInputCalibrationLevel)
     ->InitDouble(kInputCalibrationLevelParamName.c_str(), kDefaultInputCalibrationLevel, -60.0, 60.0, 0.1, "dBu");
   GetParam(kSlim)->InitDouble("Slim", 0.0, 0.0, 1.0, 0.01);
-
-  mNoiseGateTrigger.AddListener(&mNoiseGateGain);
+  GetParam(kNoiseGateAttack)
+    ->InitDouble(kNoiseGateAttackParamName.c_str(), kDefaultNoiseGateAttack, 0.1, 100.0, 0.1, "ms");
+  GetParam(kNoiseGateHold)->InitDouble(kNoiseGateHoldParamName.c_str(), kDefaultNoiseGateHold, 0.0, 500.0, 0.1, "ms");
+  GetParam(kNoiseGateRelease)
+    ->InitDouble(kNoiseGateReleaseParamName.c_str(), kDefaultNoiseGateRelease, 1.0, 1000.0, 0.1, "ms");
+  GetParam(kIRTrim)->InitBool(kIRTrimParamName.c_str(), kDefaultIRTrim);
+  GetParam(kIRTrimThreshold)
+    ->InitDouble(kIRTrimThresholdParamName.c_str(), dsp::kDefaultIRTrimThreshold, -150.0, -30.0, 1.0, "dB");
+  GetParam(kIRMinimumPhase)->InitBool(kIRMinimumPhaseParamName.c_str(), kDefaultIRMinimumPhase);
 
   mMakeGraphicsFunc = [&]() {
 
@@ -185,16 +206,8 @@ NeuralAmpModeler::NeuralAmpModeler(const InstanceInfo& info)
     auto loadModelCompletionHandler = [&](const WDL_String& fileName, const WDL_String& path) {
       if (fileName.GetLength())
       {
-        // Sets mNAMPath and mStagedNAM
-        const std::string msg = _StageModel(fileName);
-        // TODO error messages like the IR loader.
-        if (msg.size())
-        {
-          std::stringstream ss;
-          ss << "Failed to load NAM model. Message:\n\n" << msg;
-          _ShowMessageBox(GetUI(), ss.str().c_str(), "Failed to load model!", kMB_OK);
-        }
-        std::cout << "Loaded: " << fileName.Get() << std::endl;
+        // Sets mNAMPath; mStagedModel gets filled in the background. See _HandleLoaderResults().
+        _StageModel(fileName, true);
       }
     };
 
@@ -202,16 +215,7 @@ NeuralAmpModeler::NeuralAmpModeler(const InstanceInfo& info)
     auto loadIRCompletionHandler = [&](const WDL_String& fileName, const WDL_String& path) {
       if (fileName.GetLength())
       {
-        mIRPath = fileName;
-        const dsp::wav::LoadReturnCode retCode = _StageIR(fileName);
-        if (retCode != dsp::wav::LoadReturnCode::SUCCESS)
-        {
-          std::stringstream message;
-          message << "Failed to load IR file " << fileName.Get() << ":\n";
-          message << dsp::wav::GetMsgForLoadReturnCode(retCode);
-
-          _ShowMessageBox(GetUI(), message.str().c_str(), "Failed to load IR!", kMB_OK);
-        }
+        _StageIR(fileName, true);
       }
     };
 
@@ -314,87 +318,65 @@ NeuralAmpModeler::NeuralAmpModeler(const InstanceInfo& info)
   };
 }
 
-NeuralAmpModeler::~NeuralAmpModeler()
-{
-  _DeallocateIOPointers();
-}
+NeuralAmpModeler::~NeuralAmpModeler() = default;
 
 void NeuralAmpModeler::ProcessBlock(iplug::sample** inputs, iplug::sample** outputs, int nFrames)
 {
+  // Checked in sanitizer builds (see RealtimeSanitizer.h)
+  NAM_REALTIME_SCOPE();
   const size_t numChannelsExternalIn = (size_t)NInChansConnected();
   const size_t numChannelsExternalOut = (size_t)NOutChansConnected();
-  const size_t numChannelsInternal = kNumChannelsInternal;
   const size_t numFrames = (size_t)nFrames;
-  const double sampleRate = GetSampleRate();
-
-  // Disable floating point denormals
-  std::fenv_t fe_state;
-  std::feholdexcept(&fe_state);
-  disable_denormals();
-
-  _PrepareBuffers(numChannelsInternal, numFrames);
-  // Input is collapsed to mono in preparation for the NAM.
-  _ProcessInput(inputs, numFrames, numChannelsExternalIn, numChannelsInternal);
-  _ApplyDSPStaging();
-  const bool noiseGateActive = GetParam(kNoiseGateActive)->Value();
-  const bool toneStackActive = GetParam(kEQActive)->Value();
-
-  // Noise gate trigger
-  sample** triggerOutput = mInputPointers;
-  if (noiseGateActive)
-  {
-    const double time = 0.01;
-    const double threshold = GetParam(kNoiseGateThreshold)->Value(); // GetParam...
-    const double ratio = 0.1; // Quadratic...
-    const double openTime = 0.005;
-    const double holdTime = 0.01;
-    const double closeTime = 0.05;
-    const dsp::noise_gate::TriggerParams triggerParams(time, threshold, ratio, openTime, holdTime, closeTime);
-    mNoiseGateTrigger.SetParams(triggerParams);
-    mNoiseGateTrigger.SetSampleRate(sampleRate);
-    triggerOutput = mNoiseGateTrigger.Process(mInputPointers, numChannelsInternal, numFrames);
-  }
 
-  if (mModel != nullptr)
-  {
-    mModel->process(triggerOutput, mOutputPointers, nFrames);
+  const bool modelSwapped = _ApplyDSPStaging();
+
+  ProcessingChain::BlockSettings settings;
+  settings.inputGain = mInputGain;
+  settings.outputGain = mOutputGain;
+  // The crossfade covers the change in gains that comes with a new model.
+  settings.smoothGains = !modelSwapped;
+  settings.noiseGateActive = GetParam(kNoiseGateActive)->Value();
+  settings.noiseGateThreshold = GetParam(kNoiseGateThreshold)->Value();
+  settings.noiseGateOpenTime = 0.001 * GetParam(kNoiseGateAttack)->Value();
+  settings.noiseGateHoldTime = 0.001 * GetParam(kNoiseGateHold)->Value();
+  settings.noiseGateCloseTime = 0.001 * GetParam(kNoiseGateRelease)->Value();
+  settings.toneStackActive = GetParam(kEQActive)->Value();
+  // The chain smooths these and hands them to the tone stack.
+  settings.toneStackValues[(size_t)dsp::tone_stack::Param::Bass] = GetParam(kToneBass)->Value();
+  settings.toneStackValues[(size_t)dsp::tone_stack::Param::Middle] = GetParam(kToneMid)->Value();
+  settings.toneStackValues[(size_t)dsp::tone_stack::Param::Treble] = GetParam(kToneTreble)->Value();
+  settings.outgoingModelGain = mOutgoingModelGain;
+  const bool irActive = GetParam(kIRToggle)->Value();
+  ConvolutionIR* ir = irActive ? mIR.get() : nullptr;
+  ConvolutionIR* outgoingIR = irActive ? mOutgoingIR.get() : nullptr;
+
+  // Some hosts send more than GetBlockSize() frames; the processing chain only has room for that many, so go through
+  // in pieces.
+  const size_t maxChunkSize = mProcessingChain.GetMaxBlockSize();
+  // Not reset yet, so there's nowhere to process anything
+  if (maxChunkSize == 0)
+  {
+    for (size_t c = 0; c < numChannelsExternalOut; c++)
+      std::fill(outputs[c], outputs[c] + numFrames, (iplug::sample)0.0);
+    return;
   }
-  else
+  for (size_t offset = 0; offset < numFrames; offset += maxChunkSize)
   {
-    _FallbackDSP(triggerOutput, mOutputPointers, numChannelsInternal, numFrames);
+    const size_t chunkSize = std::min(maxChunkSize, numFrames - offset);
+    for (size_t c = 0; c < numChannelsExternalIn; c++)
+      mInputChunkPointers[c] = inputs[c] + offset;
+    for (size_t c = 0; c < numChannelsExternalOut; c++)
+      mOutputChunkPointers[c] = outputs[c] + offset;
+
+    mProcessingChain.Process(mInputChunkPointers.data(), mOutputChunkPointers.data(), numChannelsExternalIn,
+                             numChannelsExternalOut, chunkSize, mModel.get(), ir, settings, mOutgoingModel.get(),
+                             outgoingIR);
+
+    // * Output of input leveling (inputs -> input pointers),
+    // * Output of output leveling (output pointers -> outputs)
+    _UpdateMeters(mProcessingChain.GetInputPointers(), mOutputChunkPointers.data(), chunkSize, kNumChannelsInternal,
+                  numChannelsExternalOut);
   }
-  // Apply the noise gate after the NAM
-  sample** gateGainOutput =
-    noiseGateActive ? mNoiseGateGain.Process(mOutputPointers, numChannelsInternal, numFrames) : mOutputPointers;
-
-  sample** toneStackOutPointers = (toneStackActive && mToneStack != nullptr)
-                                    ? mToneStack->Process(gateGainOutput, numChannelsInternal, nFrames)
-                                    : gateGainOutput;
-
-  sample** irPointers = toneStackOutPointers;
-  if (mIR != nullptr && GetParam(kIRToggle)->Value())
-    irPointers = mIR->Process(toneStackOutPointers, numChannelsInternal, numFrames);
-
-  // And the HPF for DC offset (Issue 271)
-  const double highPassCutoffFreq = kDCBlockerFrequency;
-  // const double lowPassCutoffFreq = 20000.0;
-  const recursive_linear_filter::HighPassParams highPassParams(sampleRate, highPassCutoffFreq);
-  // const recursive_linear_filter::LowPassParams lowPassParams(sampleRate, lowPassCutoffFreq);
-  mHighPass.SetParams(highPassParams);
-  // mLowPass.SetParams(lowPassParams);
-  sample** hpfPointers = mHighPass.Process(irPointers, numChannelsInternal, numFrames);
-  // sample** lpfPointers = mLowPass.Process(hpfPointers, numChannelsInternal, numFrames);
-
-  // restore previous floating point state
-  std::feupdateenv(&fe_state);
-
-  // Let's get outta here
-  // This is where we exit mono for whatever the output requires.
-  _ProcessOutput(hpfPointers, outputs, numFrames, numChannelsInternal, numChannelsExternalOut);
-  // _ProcessOutput(lpfPointers, outputs, numFrames, numChannelsInternal, numChannelsExternalOut);
-  // * Output of input leveling (inputs -> mInputPointers),
-  // * Output of output leveling (mOutputPointers -> outputs)
-  _UpdateMeters(mInputPointers, outputs, numFrames, numChannelsInternal, numChannelsExternalOut);
 }
 
 void NeuralAmpModeler::OnReset()
@@ -402,17 +384,19 @@ void NeuralAmpModeler::OnReset()
   const auto sampleRate = GetSampleRate();
   const int maxBlockSize = GetBlockSize();
 
-  // Tail is because the HPF DC blocker has a decay.
-  // 10 cycles should be enough to pass the VST3 tests checking tail behavior.
-  // I'm ignoring the model & IR, but it's not the end of the world.
-  const int tailCycles = 10;
-  SetTailSize(tailCycles * (int)(sampleRate / kDCBlockerFrequency));
   mInputSender.Reset(sampleRate);
   mOutputSender.Reset(sampleRate);
+  mInputChunkPointers.resize(MaxNChannels(ERoute::kInput));
+  mOutputChunkPointers.resize(MaxNChannels(ERoute::kOutput));
+  // What's being crossfaded from was made for the old settings, and would throw or allocate with the new ones. It's
+  // not processed once the crossfades are over, and the next block's _ApplyDSPStaging() retires it. (The audio thread
+  // is the only one that retires things; see Reclaimer.)
+  mProcessingChain.EndCrossfades();
   // If there is a model or IR loaded, they need to be checked for resampling.
   _ResetModelAndIR(sampleRate, GetBlockSize());
-  mToneStack->Reset(sampleRate, maxBlockSize);
+  mProcessingChain.Reset(sampleRate, maxBlockSize);
   _UpdateLatency();
+  _UpdateTail();
 }
 
 void NeuralAmpModeler::OnIdle()
@@ -420,6 +404,25 @@ void NeuralAmpModeler::OnIdle()
   mInputSender.TransmitData(*this);
   mOutputSender.TransmitData(*this);
 
+  _HandleLoaderResults();
+  // Whatever the audio thread swapped out since
+  mReclaimer.Collect();
+
+  // The IR processing params only apply at load time. While one of them is being dragged, the IR isn't loaded again
+  // for every value it passes through, only once they've stopped changing.
+  const dsp::IRProcessing irProcessing = _GetIRProcessingFromParams();
+  const auto now = std::chrono::steady_clock::now();
+  if (irProcessing != mLatestIRProcessing)
+  {
+    mLatestIRProcessing = irProcessing;
+    mIRProcessingChangeTime = now;
+  }
+  else if (mIRPath.GetLength() && irProcessing != mIRProcessing
+           && now - mIRProcessingChangeTime >= kIRProcessingSettleTime)
+  {
+    _StageIR(mIRPath);
+  }
+
   if (mNewModelLoadedInDSP)
   {
     if (auto* pGraphics = GetUI())
@@ -489,14 +492,14 @@ void NeuralAmpModeler::OnUIOpen()
     SendControlMsgFromDelegate(kCtrlTagModelFileBrowser, kMsgTagLoadedModel, mNAMPath.GetLength(), mNAMPath.Get());
     // If it's not loaded yet, then mark as failed.
     // If it's yet to be loaded, then the completion handler will set us straight once it runs.
-    if (mModel == nullptr && mStagedModel == nullptr)
+    if (mModel == nullptr && !mStagedModel.HasStaged() && !mLoader.IsLoading(BackgroundLoader::Kind::Model))
       SendControlMsgFromDelegate(kCtrlTagModelFileBrowser, kMsgTagLoadFailed);
   }
 
   if (mIRPath.GetLength())
   {
     SendControlMsgFromDelegate(kCtrlTagIRFileBrowser, kMsgTagLoadedIR, mIRPath.GetLength(), mIRPath.Get());
-    if (mIR == nullptr && mStagedIR == nullptr)
+    if (mIR == nullptr && !mStagedIR.HasStaged() && !mLoader.IsLoading(BackgroundLoader::Kind::IR))
       SendControlMsgFromDelegate(kCtrlTagIRFileBrowser, kMsgTagLoadFailed);
   }
 
@@ -504,6 +507,7 @@ void NeuralAmpModeler::OnUIOpen()
   {
     _UpdateControlsFromModel();
   }
+  _UpdateControlsFromIR();
 }
 
 void NeuralAmpModeler::OnParamChange(int paramIdx)
@@ -517,10 +521,7 @@ void NeuralAmpModeler::OnParamChange(int paramIdx)
     // Changes to the output gain
     case kOutputLevel:
     case kOutputMode: _SetOutputGain(); break;
-    // Tone stack:
-    case kToneBass: mToneStack->SetParam("bass", GetParam(paramIdx)->Value()); break;
-    case kToneMid: mToneStack->SetParam("middle", GetParam(paramIdx)->Value()); break;
-    case kToneTreble: mToneStack->SetParam("treble", GetParam(paramIdx)->Value()); break;
+    // (The tone stack knobs are read in ProcessBlock().)
     case kSlim: _ApplySlimParamToLoadedNAMs(); break;
     default: break;
   }
@@ -548,8 +549,22 @@ bool NeuralAmpModeler::OnMessage(int msgTag, int ctrlTag, int dataSize, const vo
 {
   switch (msgTag)
   {
-    case kMsgTagClearModel: mShouldRemoveModel = true; return true;
-    case kMsgTagClearIR: mShouldRemoveIR = true; return true;
+    case kMsgTagClearModel:
+      // Anything that's on its way in shouldn't make it.
+      mLoader.Cancel(BackgroundLoader::Kind::Model);
+      mStagedModel.Unstage();
+      mNAMPath.Set("");
+      mShouldRemoveModel = true;
+      return true;
+    case kMsgTagClearIR:
+      mLoader.Cancel(BackgroundLoader::Kind::IR);
+      mStagedIR.Unstage();
+      mIRPath.Set("");
+      mShouldRemoveIR = true;
+      mIRLength = 0;
+      mIRUnprocessedLength = 0;
+      _UpdateControlsFromIR();
+      return true;
     case kMsgTagHighlightColor:
     {
       mHighLightColor.Set((const char*)pData);
@@ -578,154 +593,101 @@ bool NeuralAmpModeler::OnMessage(int msgTag, int ctrlTag, int dataSize, const vo
 
 // Private methods ============================================================
 
-void NeuralAmpModeler::_AllocateIOPointers(const size_t nChans)
-{
-  if (mInputPointers != nullptr)
-    throw std::runtime_error("Tried to re-allocate mInputPointers without freeing");
-  mInputPointers = new sample*[nChans];
-  if (mInputPointers == nullptr)
-    throw std::runtime_error("Failed to allocate pointer to input buffer!\n");
-  if (mOutputPointers != nullptr)
-    throw std::runtime_error("Tried to re-allocate mOutputPointers without freeing");
-  mOutputPointers = new sample*[nChans];
-  if (mOutputPointers == nullptr)
-    throw std::runtime_error("Failed to allocate pointer to output buffer!\n");
-}
-
-void NeuralAmpModeler::_ApplyDSPStaging()
+bool NeuralAmpModeler::_ApplyDSPStaging()
 {
-  // Remove marked modules
-  if (mShouldRemoveModel)
+  bool modelSwapped = false;
+  // Only swap things out when the old module has somewhere to go. Otherwise, try again next block.
+  // Finished crossfades
+  if (!mProcessingChain.IsModelCrossfading())
   {
-    mModel = nullptr;
-    mNAMPath.Set("");
-    mShouldRemoveModel = false;
-    mModelCleared = true;
-    _UpdateLatency();
-    _SetInputGain();
-    _SetOutputGain();
+    mReclaimer.Retire(mOutgoingModel);
   }
-  if (mShouldRemoveIR)
+  if (!mProcessingChain.IsIRCrossfading())
   {
-    mIR = nullptr;
-    mIRPath.Set("");
-    mShouldRemoveIR = false;
+    mReclaimer.Retire(mOutgoingIR);
   }
-  // Move things from staged to live
-  if (mStagedModel != nullptr)
+
+  // Remove marked modules, or move things from staged to live.
+  // Either way, it's a crossfade from what's live now, and only one at a time.
+  if (!mProcessingChain.IsModelCrossfading() && mOutgoingModel == nullptr
+      && (mShouldRemoveModel || mStagedModel.HasStaged()))
   {
-    mModel = std::move(mStagedModel);
-    mStagedModel = nullptr;
-    mNewModelLoadedInDSP = true;
+    const double previousOutputGain = mOutputGain;
+    modelSwapped = true;
+    mOutgoingModel = std::move(mModel);
+    if (mShouldRemoveModel)
+    {
+      mShouldRemoveModel = false;
+      mModelCleared = true;
+    }
+    else
+    {
+      mModel = mStagedModel.Take();
+      mNewModelLoadedInDSP = true;
+    }
     _UpdateLatency();
+    _UpdateTail();
     _SetInputGain();
     _SetOutputGain();
+    mOutgoingModelGain = previousOutputGain / mOutputGain;
+    if (!mProcessingChain.StartModelCrossfade())
+    {
+      mReclaimer.Retire(mOutgoingModel);
+    }
   }
-  if (mStagedIR != nullptr)
-  {
-    mIR = std::move(mStagedIR);
-    mStagedIR = nullptr;
-  }
-}
-
-void NeuralAmpModeler::_DeallocateIOPointers()
-{
-  if (mInputPointers != nullptr)
-  {
-    delete[] mInputPointers;
-    mInputPointers = nullptr;
-  }
-  if (mInputPointers != nullptr)
-    throw std::runtime_error("Failed to deallocate pointer to input buffer!\n");
-  if (mOutputPointers != nullptr)
+  if (!mProcessingChain.IsIRCrossfading() && mOutgoingIR == nullptr && (mShouldRemoveIR || mStagedIR.HasStaged()))
   {
-    delete[] mOutputPointers;
-    mOutputPointers = nullptr;
+    mOutgoingIR = std::move(mIR);
+    if (mShouldRemoveIR)
+    {
+      mShouldRemoveIR = false;
+    }
+    else
+    {
+      mIR = mStagedIR.Take();
+    }
+    _UpdateTail();
+    if (!mProcessingChain.StartIRCrossfade())
+    {
+      mReclaimer.Retire(mOutgoingIR);
+    }
   }
-  if (mOutputPointers != nullptr)
-    throw std::runtime_error("Failed to deallocate pointer to output buffer!\n");
-}
-
-void NeuralAmpModeler::_FallbackDSP(iplug::sample** inputs, iplug::sample** outputs, const size_t numChannels,
-                                    const size_t numFrames)
-{
-  for (auto c = 0; c < numChannels; c++)
-    for (auto s = 0; s < numFrames; s++)
-      mOutputArray[c][s] = mInputArray[c][s];
+  return modelSwapped;
 }
 
 void NeuralAmpModeler::_ResetModelAndIR(const double sampleRate, const int maxBlockSize)
 {
+  // Staged and loading modules
+  mLoader.Reset(sampleRate, maxBlockSize);
+
   // Model
-  if (mStagedModel != nullptr)
-  {
-    mStagedModel->Reset(sampleRate, maxBlockSize);
-  }
-  else if (mModel != nullptr)
+  if (mModel != nullptr)
   {
     mModel->Reset(sampleRate, maxBlockSize);
   }
 
   // IR
-  if (mStagedIR != nullptr)
+  // Made again in the background, with a layout for the new block size; the old one keeps going until it's ready (see
+  // ProcessingChain::ProcessIR()). Rates that it's been at before don't need resampling again.
+  if (mIR != nullptr && (mIR->GetSampleRate() != sampleRate || mIR->GetMaxBlockSize() != maxBlockSize))
   {
-    const double irSampleRate = mStagedIR->GetSampleRate();
-    if (irSampleRate != sampleRate)
-    {
-      const auto irData = mStagedIR->GetData();
-      mStagedIR = std::make_unique<dsp::ImpulseResponse>(irData, sampleRate);
-    }
-  }
-  else if (mIR != nullptr)
-  {
-    const double irSampleRate = mIR->GetSampleRate();
-    if (irSampleRate != sampleRate)
-    {
-      const auto irData = mIR->GetData();
-      mStagedIR = std::make_unique<dsp::ImpulseResponse>(irData, sampleRate);
-    }
+    mLoader.Resample(mIR->GetSource());
   }
 }
 
 void NeuralAmpModeler::_SetInputGain()
 {
-  iplug::sample inputGainDB = GetParam(kInputLevel)->Value();
-  // Input calibration
-  if ((mModel != nullptr) && (mModel->HasInputLevel()) && GetParam(kCalibrateInput)->Bool())
-  {
-    inputGainDB += GetParam(kInputCalibrationLevel)->Value() - mModel->GetInputLevel();
-  }
+  const double inputGainDB =
+    ProcessingChain::GetInputGainDB(mModel.get(), GetParam(kInputLevel)->Value(), GetParam(kCalibrateInput)->Bool(),
+                                    GetParam(kInputCalibrationLevel)->Value());
   mInputGain = DBToAmp(inputGainDB);
 }
 
 void NeuralAmpModeler::_SetOutputGain()
 {
-  double gainDB = GetParam(kOutputLevel)->Value();
-  if (mModel != nullptr)
-  {
-    const int outputMode = GetParam(kOutputMode)->Int();
-    switch (outputMode)
-    {
-      case 1: // Normalized
-        if (mModel->HasLoudness())
-        {
-          const double loudness = mModel->GetLoudness();
-          const double targetLoudness = -18.0;
-          gainDB += (targetLoudness - loudness);
-        }
-        break;
-      case 2: // Calibrated
-        if (mModel->HasOutputLevel())
-        {
-          const double inputLevel = GetParam(kInputCalibrationLevel)->Value();
-          const double outputLevel = mModel->GetOutputLevel();
-          gainDB += (outputLevel - inputLevel);
-        }
-        break;
-      case 0: // Raw
-      default: break;
-    }
-  }
+  const double gainDB =
+    ProcessingChain::GetOutputGainDB(mModel.get(), GetParam(kOutputLevel)->Value(), GetParam(kOutputMode)->Int(),
+                                     GetParam(kInputCalibrationLevel)->Value());
   mOutputGain = DBToAmp(gainDB);
 }
 
@@ -739,194 +701,99 @@ void NeuralAmpModeler::_ApplySlimParamToLoadedNAMs()
       s->SetSlimmableSize(v);
   };
   apply(mModel.get());
-  apply(mStagedModel.get());
+  mLoader.SetSlim(v);
 }
 
-std::string NeuralAmpModeler::_StageModel(const WDL_String& modelPath)
+void NeuralAmpModeler::_StageModel(const WDL_String& modelPath, const bool fromUser)
 {
-  WDL_String previousNAMPath = mNAMPath;
-  try
-  {
-    auto dspPath = std::filesystem::u8path(modelPath.Get());
-    std::unique_ptr<nam::DSP> model = nam::get_dsp(dspPath);
-
-    // Check that the model has 1 input and 1 output channel
-    if (model->NumInputChannels() != 1)
-    {
-      throw std::runtime_error("Model must have 1 input channel, but has " + std::to_string(model->NumInputChannels()));
-    }
-    if (model->NumOutputChannels() != 1)
-    {
-      throw std::runtime_error("Model must have 1 output channel, but has "
-                               + std::to_string(model->NumOutputChannels()));
-    }
-
-    std::unique_ptr<ResamplingNAM> temp = std::make_unique<ResamplingNAM>(std::move(model), GetSampleRate());
-    temp->Reset(GetSampleRate(), GetBlockSize());
-    if (nam::SlimmableModel* slimmable = temp->GetSlimmableModel())
-    {
-      slimmable->SetSlimmableSize(GetParam(kSlim)->Value());
-    }
-    mStagedModel = std::move(temp);
-    mNAMPath = modelPath;
-    SendControlMsgFromDelegate(kCtrlTagModelFileBrowser, kMsgTagLoadedModel, mNAMPath.GetLength(), mNAMPath.Get());
-  }
-  catch (std::runtime_error& e)
-  {
-    SendControlMsgFromDelegate(kCtrlTagModelFileBrowser, kMsgTagLoadFailed);
-
-    if (mStagedModel != nullptr)
-    {
-      mStagedModel = nullptr;
-    }
-    mNAMPath = previousNAMPath;
-    std::cerr << "Failed to read DSP module" << std::endl;
-    std::cerr << e.what() << std::endl;
-    return e.what();
-  }
-  return "";
+  mNAMPath = modelPath;
+  mLoader.Load(BackgroundLoader::Kind::Model, modelPath.Get(), fromUser);
 }
 
-dsp::wav::LoadReturnCode NeuralAmpModeler::_StageIR(const WDL_String& irPath)
+void NeuralAmpModeler::_StageIR(const WDL_String& irPath, const bool fromUser)
 {
-  // FIXME it'd be better for the path to be "staged" as well. Just in case the
-  // path and the model got caught on opposite sides of the fence...
-  WDL_String previousIRPath = mIRPath;
-  const double sampleRate = GetSampleRate();
-  dsp::wav::LoadReturnCode wavState = dsp::wav::LoadReturnCode::ERROR_OTHER;
-  try
-  {
-    auto irPathU8 = std::filesystem::u8path(irPath.Get());
-    mStagedIR = std::make_unique<dsp::ImpulseResponse>(irPathU8.string().c_str(), sampleRate);
-    wavState = mStagedIR->GetWavState();
-  }
-  catch (std::runtime_error& e)
-  {
-    wavState = dsp::wav::LoadReturnCode::ERROR_OTHER;
-    std::cerr << "Caught unhandled exception while attempting to load IR:" << std::endl;
-    std::cerr << e.what() << std::endl;
-  }
-
-  if (wavState == dsp::wav::LoadReturnCode::SUCCESS)
-  {
-    mIRPath = irPath;
-    SendControlMsgFromDelegate(kCtrlTagIRFileBrowser, kMsgTagLoadedIR, mIRPath.GetLength(), mIRPath.Get());
-  }
-  else
-  {
-    if (mStagedIR != nullptr)
-    {
-      mStagedIR = nullptr;
-    }
-    mIRPath = previousIRPath;
-    SendControlMsgFromDelegate(kCtrlTagIRFileBrowser, kMsgTagLoadFailed);
-  }
-
-  return wavState;
+  mIRPath = irPath;
+  mIRProcessing = _GetIRProcessingFromParams();
+  mLoader.SetIRProcessing(mIRProcessing);
+  mLoader.Load(BackgroundLoader::Kind::IR, irPath.Get(), fromUser);
 }
 
-size_t NeuralAmpModeler::_GetBufferNumChannels() const
+dsp::IRProcessing NeuralAmpModeler::_GetIRProcessingFromParams() const
 {
-  // Assumes input=output (no mono->stereo effects)
-  return mInputArray.size();
+  dsp::IRProcessing processing;
+  processing.trim = GetParam(kIRTrim)->Bool();
+  processing.trimThreshold = GetParam(kIRTrimThreshold)->Value();
+  processing.minimumPhase = GetParam(kIRMinimumPhase)->Bool();
+  return processing;
 }
 
-size_t NeuralAmpModeler::_GetBufferNumFrames() const
+void NeuralAmpModeler::_HandleLoaderResults()
 {
-  if (_GetBufferNumChannels() == 0)
-    return 0;
-  return mInputArray[0].size();
-}
+  BackgroundLoader::Result result;
+  while (mLoader.PopResult(result))
+  {
+    const bool isModel = result.kind == BackgroundLoader::Kind::Model;
+    const int ctrlTag = isModel ? kCtrlTagModelFileBrowser : kCtrlTagIRFileBrowser;
+    WDL_String& path = isModel ? mNAMPath : mIRPath;
 
-void NeuralAmpModeler::_InitToneStack()
-{
-  // If you want to customize the tone stack, then put it here!
-  mToneStack = std::make_unique<dsp::tone_stack::BasicNamToneStack>();
-}
-void NeuralAmpModeler::_PrepareBuffers(const size_t numChannels, const size_t numFrames)
-{
-  const bool updateChannels = numChannels != _GetBufferNumChannels();
-  const bool updateFrames = updateChannels || (_GetBufferNumFrames() != numFrames);
-  //  if (!updateChannels && !updateFrames)  // Could we do this?
-  //    return;
+    if (result.success)
+    {
+      const int msgTag = isModel ? kMsgTagLoadedModel : kMsgTagLoadedIR;
+      SendControlMsgFromDelegate(ctrlTag, msgTag, (int)result.path.size(), result.path.c_str());
+      std::cout << "Loaded: " << result.path << std::endl;
+      if (!isModel)
+      {
+        mIRLength = result.irLength;
+        mIRUnprocessedLength = result.irUnprocessedLength;
+        _UpdateControlsFromIR();
+      }
+      continue;
+    }
 
-  if (updateChannels)
-  {
-    _PrepareIOPointers(numChannels);
-    mInputArray.resize(numChannels);
-    mOutputArray.resize(numChannels);
-  }
-  if (updateFrames)
-  {
-    for (auto c = 0; c < mInputArray.size(); c++)
+    SendControlMsgFromDelegate(ctrlTag, kMsgTagLoadFailed);
+    // Unless something else was picked in the meantime, go back to what's actually loaded.
+    if (result.path == path.Get())
     {
-      mInputArray[c].resize(numFrames);
-      std::fill(mInputArray[c].begin(), mInputArray[c].end(), 0.0);
+      path.Set(result.previousPath.c_str());
     }
-    for (auto c = 0; c < mOutputArray.size(); c++)
+    if (isModel)
     {
-      mOutputArray[c].resize(numFrames);
-      std::fill(mOutputArray[c].begin(), mOutputArray[c].end(), 0.0);
+      std::cerr << "Failed to read DSP module" << std::endl;
+      std::cerr << result.errorMessage << std::endl;
+    }
+    else
+    {
+      std::cerr << "Failed to load IR:" << std::endl;
+      std::cerr << result.errorMessage << std::endl;
     }
-  }
-  // Would these ever get changed by something?
-  for (auto c = 0; c < mInputArray.size(); c++)
-    mInputPointers[c] = mInputArray[c].data();
-  for (auto c = 0; c < mOutputArray.size(); c++)
-    mOutputPointers[c] = mOutputArray[c].data();
-}
 
-void NeuralAmpModeler::_PrepareIOPointers(const size_t numChannels)
-{
-  _DeallocateIOPointers();
-  _AllocateIOPointers(numChannels);
+    if (result.fromUser && GetUI() != nullptr)
+    {
+      std::stringstream message;
+      if (isModel)
+      {
+        message << "Failed to load NAM model. Message:\n\n" << result.errorMessage;
+        _ShowMessageBox(GetUI(), message.str().c_str(), "Failed to load model!", kMB_OK);
+      }
+      else
+      {
+        message << "Failed to load IR file " << result.path << ":\n";
+        message << dsp::wav::GetMsgForLoadReturnCode(result.wavState);
+        _ShowMessageBox(GetUI(), message.str().c_str(), "Failed to load IR!", kMB_OK);
+      }
+    }
+  }
 }
 
-void NeuralAmpModeler::_ProcessInput(iplug::sample** inputs, const size_t nFrames, const size_t nChansIn,
-                                     const size_t nChansOut)
+void NeuralAmpModeler::_UpdateControlsFromIR()
 {
-  // We'll assume that the main processing is mono for now. We'll handle dual amps later.
-  if (nChansOut != 1)
+  if (auto* pGraphics = GetUI())
   {
-    std::stringstream ss;
-    ss << "Expected mono output, but " << nChansOut << " output channels are requested!";
-    throw std::runtime_error(ss.str());
+    IRInfo irInfo;
+    irInfo.length = mIRLength;
+    irInfo.unprocessedLength = mIRUnprocessedLength;
+    static_cast<NAMSettingsPageControl*>(pGraphics->GetControlWithTag(kCtrlTagSettingsBox))->SetIRInfo(irInfo);
   }
-
-  // On the standalone, we can probably assume that the user has plugged into only one input and they expect it to be
-  // carried straight through. Don't apply any division over nChansIn because we're just "catching anything out there."
-  // However, in a DAW, it's probably something providing stereo, and we want to take the average in order to avoid
-  // doubling the loudness. (This would change w/ double mono processing)
-  double gain = mInputGain;
-#ifndef APP_API
-  gain /= (float)nChansIn;
-#endif
-  // Assume _PrepareBuffers() was already called
-  for (size_t c = 0; c < nChansIn; c++)
-    for (size_t s = 0; s < nFrames; s++)
-      if (c == 0)
-        mInputArray[0][s] = gain * inputs[c][s];
-      else
-        mInputArray[0][s] += gain * inputs[c][s];
-}
-
-void NeuralAmpModeler::_ProcessOutput(iplug::sample** inputs, iplug::sample** outputs, const size_t nFrames,
-                                      const size_t nChansIn, const size_t nChansOut)
-{
-  const double gain = mOutputGain;
-  // Assume _PrepareBuffers() was already called
-  if (nChansIn != 1)
-    throw std::runtime_error("Plugin is supposed to process in mono.");
-  // Broadcast the internal mono stream to all output channels.
-  const size_t cin = 0;
-  for (auto cout = 0; cout < nChansOut; cout++)
-    for (auto s = 0; s < nFrames; s++)
-#ifdef APP_API // Ensure valid output to interface
-      outputs[cout][s] = std::clamp(gain * inputs[cin][s], -1.0, 1.0);
-#else // In a DAW, other things may come next and should be able to handle large
-      // values.
-      outputs[cout][s] = gain * inputs[cin][s];
-#endif
 }
 
 void NeuralAmpModeler::_UpdateControlsFromModel()
@@ -980,6 +847,16 @@ void NeuralAmpModeler::_UpdateLatency()
   }
 }
 
+void NeuralAmpModeler::_UpdateTail()
+{
+  const size_t irLength = mIR != nullptr ? mIR->GetLength() : 0;
+  const int tail = (int)mProcessingChain.GetTailSize(mModel.get(), irLength);
+  if (GetTailSize() != tail)
+  {
+    SetTailSize(tail);
+  }
+}
+
 void NeuralAmpModeler::_UpdateMeters(sample** inputPointer, sample** outputPointer, const size_t nFrames,
                                      const size_t nChansIn, const size_t nChansOut)
 {
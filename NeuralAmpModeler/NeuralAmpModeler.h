@@ -1,23 +1,28 @@
 #pragma once
 
-#include "../AudioDSPTools/dsp/ImpulseResponse.h"
-#include "../AudioDSPTools/dsp/NoiseGate.h"
+#include <chrono>
+
 #include "../AudioDSPTools/dsp/dsp.h"
 #include "../AudioDSPTools/dsp/wav.h"
-#include "../AudioDSPTools/dsp/ResamplingContainer/ResamplingContainer.h"
 #include "../NeuralAmpModelerCore/NAM/dsp.h"
-#include "../NeuralAmpModelerCore/NAM/slimmable.h"
 
 #include "Colors.h"
-#include "ToneStack.h"
+#include "ConvolutionIR.h"
+#include "Loader.h"
+#include "ProcessingChain.h"
+#include "ResamplingNAM.h"
+#include "Staging.h"
 
 #include "IPlug_include_in_plug_hdr.h"
 #include "ISender.h"
 
 
 const int kNumPresets = 1;
-// The plugin is mono inside
-constexpr size_t kNumChannelsInternal = 1;
+
+// See ProcessingChain.h about precision
+static_assert(std::is_same<iplug::sample, DSP_SAMPLE>::value,
+              "iPlug2's sample type has to match the processing chain's; define SAMPLE_TYPE_FLOAT along with "
+              "DSP_SAMPLE_FLOAT and NAM_SAMPLE_FLOAT.");
 
 class NAMSender : public iplug::IPeakAvgSender<>
 {
@@ -47,6 +52,14 @@ enum EParams
   kInputCalibrationLevel,
   kOutputMode,
   kSlim,
+  // Noise gate timing
+  kNoiseGateAttack,
+  kNoiseGateHold,
+  kNoiseGateRelease,
+  // What's done to IRs when they're loaded (see IRProcessing.h)
+  kIRTrim,
+  kIRTrimThreshold,
+  kIRMinimumPhase,
   kNumParams
 };
 
@@ -81,118 +94,6 @@ enum EMsgTags
   kNumMsgTags
 };
 
-// Get the sample rate of a NAM model.
-// Sometimes, the model doesn't know its own sample rate; this wrapper guesses 48k based on the way that most
-// people have used NAM in the past.
-double GetNAMSampleRate(const std::unique_ptr<nam::DSP>& model)
-{
-  // Some models are from when we didn't have sample rate in the model.
-  // For those, this wraps with the assumption that they're 48k models, which is probably true.
-  const double assumedSampleRate = 48000.0;
-  const double reportedEncapsulatedSampleRate = model->GetExpectedSampleRate();
-  const double encapsulatedSampleRate =
-    reportedEncapsulatedSampleRate <= 0.0 ? assumedSampleRate : reportedEncapsulatedSampleRate;
-  return encapsulatedSampleRate;
-};
-
-class ResamplingNAM : public nam::DSP
-{
-public:
-  // Resampling wrapper around the NAM models
-  ResamplingNAM(std::unique_ptr<nam::DSP> encapsulated, const double expected_sample_rate)
-  : nam::DSP(encapsulated->NumInputChannels(), encapsulated->NumOutputChannels(), expected_sample_rate)
-  , mEncapsulated(std::move(encapsulated))
-  , mResampler(GetNAMSampleRate(mEncapsulated))
-  {
-    // Assign the encapsulated object's processing function  to this object's member so that the resampler can use it:
-    auto ProcessBlockFunc = [&](NAM_SAMPLE** input, NAM_SAMPLE** output, int numFrames) {
-      mEncapsulated->process(input, output, numFrames);
-    };
-    mBlockProcessFunc = ProcessBlockFunc;
-
-    // Get the other information from the encapsulated NAM so that we can tell the outside world about what we're
-    // holding.
-    if (mEncapsulated->HasLoudness())
-    {
-      SetLoudness(mEncapsulated->GetLoudness());
-    }
-    if (mEncapsulated->HasInputLevel())
-    {
-      SetInputLevel(mEncapsulated->GetInputLevel());
-    }
-    if (mEncapsulated->HasOutputLevel())
-    {
-      SetOutputLevel(mEncapsulated->GetOutputLevel());
-    }
-
-    // NOTE: prewarm samples doesn't mean anything--we can prewarm the encapsulated model as it likes and be good to
-    // go.
-    // _prewarm_samples = 0;
-
-    // And be ready
-    int maxBlockSize = 2048; // Conservative
-    Reset(expected_sample_rate, maxBlockSize);
-  };
-
-  ~ResamplingNAM() = default;
-
-  void prewarm() override { mEncapsulated->prewarm(); };
-
-  void process(NAM_SAMPLE** input, NAM_SAMPLE** output, const int num_frames) override
-  {
-    if (num_frames > mMaxExternalBlockSize)
-      // We can afford to be careful
-      throw std::runtime_error("More frames were provided than the max expected!");
-
-    if (!NeedToResample())
-    {
-      mEncapsulated->process(input, output, num_frames);
-    }
-    else
-    {
-      mResampler.ProcessBlock(input, output, num_frames, mBlockProcessFunc);
-    }
-  };
-
-  int GetLatency() const { return NeedToResample() ? mResampler.GetLatency() : 0; };
-
-  void Reset(const double sampleRate, const int maxBlockSize) override
-  {
-    mExpectedSampleRate = sampleRate;
-    mMaxExternalBlockSize = maxBlockSize;
-    mResampler.Reset(sampleRate, maxBlockSize);
-
-    // Allocations in the encapsulated model (HACK)
-    // Stolen some code from the resampler; it'd be nice to have these exposed as methods? :)
-    const double mUpRatio = sampleRate / GetEncapsulatedSampleRate();
-    const auto maxEncapsulatedBlockSize = static_cast<int>(std::ceil(static_cast<double>(maxBlockSize) / mUpRatio));
-    mEncapsulated->ResetAndPrewarm(sampleRate, maxEncapsulatedBlockSize);
-  };
-
-  // So that we can let the world know if we're resampling (useful for debugging)
-  double GetEncapsulatedSampleRate() const { return GetNAMSampleRate(mEncapsulated); };
-
-  nam::SlimmableModel* GetSlimmableModel() { return dynamic_cast<nam::SlimmableModel*>(mEncapsulated.get()); }
-  const nam::SlimmableModel* GetSlimmableModel() const
-  {
-    return dynamic_cast<const nam::SlimmableModel*>(mEncapsulated.get());
-  }
-
-private:
-  bool NeedToResample() const { return GetExpectedSampleRate() != GetEncapsulatedSampleRate(); };
-  // The encapsulated NAM
-  std::unique_ptr<nam::DSP> mEncapsulated;
-
-  // The resampling wrapper
-  dsp::ResamplingContainer<NAM_SAMPLE, 1, 12> mResampler;
-
-  // Used to check that we don't get too large a block to process.
-  int mMaxExternalBlockSize = 0;
-
-  // This function is defined to conform to the interface expected by the iPlug2 resampler.
-  std::function<void(NAM_SAMPLE**, NAM_SAMPLE**, int)> mBlockProcessFunc;
-};
-
 class NeuralAmpModeler final : public iplug::Plugin
 {
 public:
@@ -213,43 +114,24 @@ public:
   bool OnMessage(int msgTag, int ctrlTag, int dataSize, const void* pData) override;
 
 private:
-  // Allocates mInputPointers and mOutputPointers
-  void _AllocateIOPointers(const size_t nChans);
   // Moves DSP modules from staging area to the main area.
-  // Also deletes DSP modules that are flagged for removal.
+  // Also removes DSP modules that are flagged for removal.
   // Exists so that we don't try to use a DSP module that's only
   // partially-instantiated.
-  void _ApplyDSPStaging();
-  // Deallocates mInputPointers and mOutputPointers
-  void _DeallocateIOPointers();
-  // Fallback that just copies inputs to outputs if mDSP doesn't hold a model.
-  void _FallbackDSP(iplug::sample** inputs, iplug::sample** outputs, const size_t numChannels, const size_t numFrames);
-  // Sizes based on mInputArray
-  size_t _GetBufferNumChannels() const;
-  size_t _GetBufferNumFrames() const;
-  void _InitToneStack();
-  // Loads a NAM model and stores it to mStagedNAM
-  // Returns an empty string on success, or an error message on failure.
-  std::string _StageModel(const WDL_String& dspFile);
-  // Loads an IR and stores it to mStagedIR.
-  // Return status code so that error messages can be relayed if
-  // it wasn't successful.
-  dsp::wav::LoadReturnCode _StageIR(const WDL_String& irPath);
+  // Runs on the audio thread, so it doesn't free anything; whatever is replaced or removed goes to mReclaimer.
+  // Swaps are crossfaded (see ProcessingChain::StartModelCrossfade()), one at a time.
+  // Returns whether the model was swapped.
+  bool _ApplyDSPStaging();
+  // Sets mNAMPath and has mLoader load the NAM model into mStagedModel in the background.
+  // fromUser: whether to tell the user with a message box if it fails.
+  void _StageModel(const WDL_String& dspFile, const bool fromUser = false);
+  // Sets mIRPath and has mLoader load the IR into mStagedIR in the background, processed according to the params.
+  void _StageIR(const WDL_String& irPath, const bool fromUser = false);
+  dsp::IRProcessing _GetIRProcessingFromParams() const;
+  // Tells the UI how the background loads went. Called by OnIdle.
+  void _HandleLoaderResults();
 
   bool _HaveModel() const { return this->mModel != nullptr; };
-  // Prepare the input & output buffers
-  void _PrepareBuffers(const size_t numChannels, const size_t numFrames);
-  // Manage pointers
-  void _PrepareIOPointers(const size_t nChans);
-  // Copy the input buffer to the object, applying input level.
-  // :param nChansIn: In from external
-  // :param nChansOut: Out to the internal of the DSP routine
-  void _ProcessInput(iplug::sample** inputs, const size_t nFrames, const size_t nChansIn, const size_t nChansOut);
-  // Copy the output to the output buffer, applying output level.
-  // :param nChansIn: In from internal
-  // :param nChansOut: Out to external
-  void _ProcessOutput(iplug::sample** inputs, iplug::sample** outputs, const size_t nFrames, const size_t nChansIn,
-                      const size_t nChansOut);
   // Resetting for models and IRs, called by OnReset
   void _ResetModelAndIR(const double sampleRate, const int maxBlockSize);
 
@@ -266,58 +148,67 @@ private:
 
   // Update all controls that depend on a model
   void _UpdateControlsFromModel();
+  // Shows how much of the IR is used on the settings page
+  void _UpdateControlsFromIR();
 
   // Make sure that the latency is reported correctly.
   void _UpdateLatency();
+  // Tells the host how long the output keeps going after the input stops, for what's loaded now.
+  void _UpdateTail();
 
   // Update level meters
   // Called within ProcessBlock().
-  // Assume _ProcessInput() and _ProcessOutput() were run immediately before.
+  // Assume mProcessingChain has just processed the block.
   void _UpdateMeters(iplug::sample** inputPointer, iplug::sample** outputPointer, const size_t nFrames,
                      const size_t nChansIn, const size_t nChansOut);
 
   // Member data
 
-  // Input arrays to NAM
-  std::vector<std::vector<iplug::sample>> mInputArray;
-  // Output from NAM
-  std::vector<std::vector<iplug::sample>> mOutputArray;
-  // Pointer versions
-  iplug::sample** mInputPointers = nullptr;
-  iplug::sample** mOutputPointers = nullptr;
+  // Buffers, noise gate, tone stack, and post-IR filters. See ProcessingChain.h
+  ProcessingChain mProcessingChain;
+  // Where each piece of a block that's too big for mProcessingChain starts. Sized in OnReset().
+  std::vector<iplug::sample*> mInputChunkPointers;
+  std::vector<iplug::sample*> mOutputChunkPointers;
 
   // Input and output gain
   double mInputGain = 1.0;
   double mOutputGain = 1.0;
 
-  // Noise gates
-  dsp::noise_gate::Trigger mNoiseGateTrigger;
-  dsp::noise_gate::Gain mNoiseGateGain;
   // The model actually being used:
   std::unique_ptr<ResamplingNAM> mModel;
   // And the IR
-  std::unique_ptr<dsp::ImpulseResponse> mIR;
+  std::unique_ptr<ConvolutionIR> mIR;
+  // What's being crossfaded from after a swap
+  std::unique_ptr<ResamplingNAM> mOutgoingModel;
+  std::unique_ptr<ConvolutionIR> mOutgoingIR;
+  // Output gain of the outgoing model relative to the current one
+  double mOutgoingModelGain = 1.0;
   // Manages switching what DSP is being used.
-  std::unique_ptr<ResamplingNAM> mStagedModel;
-  std::unique_ptr<dsp::ImpulseResponse> mStagedIR;
+  DSPStaging<ResamplingNAM> mStagedModel;
+  DSPStaging<ConvolutionIR> mStagedIR;
   // Flags to take away the modules at a safe time.
   std::atomic<bool> mShouldRemoveModel = false;
   std::atomic<bool> mShouldRemoveIR = false;
+  // Modules that the audio thread is done with are deleted by this, once OnIdle collects them.
+  Reclaimer mReclaimer;
+  // Fills mStagedModel and mStagedIR, so it comes after them.
+  BackgroundLoader mLoader{mStagedModel, mStagedIR};
 
   std::atomic<bool> mNewModelLoadedInDSP = false;
   std::atomic<bool> mModelCleared = false;
 
-  // Tone stack modules
-  std::unique_ptr<dsp::tone_stack::AbstractToneStack> mToneStack;
-
-  // Post-IR filters
-  recursive_linear_filter::HighPass mHighPass;
-  //  recursive_linear_filter::LowPass mLowPass;
-
   // Path to model's config.json or model.nam
   WDL_String mNAMPath;
   // Path to IR (.wav file)
   WDL_String mIRPath;
+  // What the IR at mIRPath was last loaded with. When the params move away from it, it's loaded again (in OnIdle).
+  dsp::IRProcessing mIRProcessing;
+  // Taps of the IR at mIRPath after and before the IRProcessing. 0 if there's none.
+  size_t mIRLength = 0;
+  size_t mIRUnprocessedLength = 0;
+  // What the params said when OnIdle last looked, and when that changed
+  dsp::IRProcessing mLatestIRProcessing;
+  std::chrono::steady_clock::time_point mIRProcessingChangeTime;
 
   WDL_String mHighLightColor{PluginColors::NAM_THEMECOLOR.ToColorCode()};
 
@@ -581,6 +581,14 @@ struct ModelInfo
   PossiblyKnownParameter outputCalibrationLevel;
 };
 
+struct IRInfo
+{
+  // Taps used, after trimming. 0 if there's no IR.
+  size_t length = 0;
+  // Taps in the file (at the plugin's sample rate)
+  size_t unprocessedLength = 0;
+};
+
 class ModelInfoControl : public IContainerBaseWithNamedChildren
 {
 public:
@@ -597,13 +605,14 @@ public:
   void Hide(bool hide) override
   {
     // Don't show me unless I have info to show!
-    IContainerBase::Hide(hide || (!mHasInfo));
+    IContainerBase::Hide(hide || (!mHasInfo && !mHasIRInfo));
   };
 
   void OnAttached() override
   {
     AddChildControl(new IVLabelControl(GetRECT().SubRectVertical(4, 0), "Model information:", mStyle));
     AddNamedChildControl(new IVLabelControl(GetRECT().SubRectVertical(4, 1), "", mStyle), mControlNames.sampleRate);
+    AddNamedChildControl(new IVLabelControl(GetRECT().SubRectVertical(4, 2), "", mStyle), mControlNames.irLength);
     // AddNamedChildControl(
     //   new IVLabelControl(GetRECT().SubRectVertical(4, 2), "", mStyle), mControlNames.inputCalibrationLevel);
     // AddNamedChildControl(
@@ -636,16 +645,31 @@ public:
     mHasInfo = true;
   };
 
+  void SetIRInfo(const IRInfo& irInfo)
+  {
+    std::stringstream ss;
+    if (irInfo.length > 0)
+    {
+      ss << "IR: " << irInfo.length << " samples";
+      if (irInfo.length < irInfo.unprocessedLength)
+        ss << " (trimmed from " << irInfo.unprocessedLength << ")";
+    }
+    static_cast<IVLabelControl*>(GetNamedChild(mControlNames.irLength))->SetStr(ss.str().c_str());
+    mHasIRInfo = irInfo.length > 0;
+  };
+
 private:
   const IVStyle mStyle;
   struct
   {
     const std::string sampleRate = "sampleRate";
+    const std::string irLength = "irLength";
     // const std::string inputCalibrationLevel = "inputCalibrationLevel";
     // const std::string outputCalibrationLevel = "outputCalibrationLevel";
   } mControlNames;
   // Do I have info?
   bool mHasInfo = false;
+  bool mHasIRInfo = false;
 };
 
 class OutputModeControl : public IVRadioButtonControl
@@ -824,6 +848,13 @@ public:
     modelInfoControl->SetModelInfo(modelInfo);
   };
 
+  void SetIRInfo(const IRInfo& irInfo)
+  {
+    auto* modelInfoControl = static_cast<ModelInfoControl*>(GetNamedChild(mControlNames.modelInfo));
+    assert(modelInfoControl != nullptr);
+    modelInfoControl->SetIRInfo(irInfo);
+  };
+
 private:
   IBitmap mBitmap;
   IBitmap mInputLevelBackgroundBitmap;
@@ -0,0 +1,158 @@
+#pragma once
+
+// Reading the weights.npy of the old config.json + weights.npy model directories (see the ones in Models/).
+// The file is mapped into memory, its header is checked, and the data go straight into the weights as floats.
+//
+// Only what NAM has written is supported: a C-ordered array of float32 or float64, in either byte order. Its shape
+// doesn't matter, as long as the data that it says are there are.
+// https://numpy.org/doc/stable/reference/generated/numpy.lib.format.html
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "MappedFile.h"
+
+namespace npy
+{
+namespace detail
+{
+// The value in the header's dictionary after 'key': (with the whitespace around it), up to the next comma outside of
+// parentheses.
+inline std::string GetValue(const std::string& header, const std::string& key)
+{
+  const std::string quotedKey = "'" + key + "'";
+  size_t start = header.find(quotedKey);
+  if (start == std::string::npos)
+    return "";
+  start = header.find(':', start + quotedKey.size());
+  if (start == std::string::npos)
+    return "";
+  start++;
+  int depth = 0;
+  size_t end = start;
+  for (; end < header.size(); end++)
+  {
+    const char c = header[end];
+    if (c == '(')
+      depth++;
+    else if (c == ')')
+      depth--;
+    else if ((c == ',' && depth == 0) || c == '}')
+      break;
+  }
+  const std::string value = header.substr(start, end - start);
+  const size_t first = value.find_first_not_of(" ");
+  const size_t last = value.find_last_not_of(" ");
+  return first == std::string::npos ? "" : value.substr(first, last - first + 1);
+}
+
+// E.g. "(13801,)" or "(1, 13801)"; "()" is one element. Returns false if it isn't a tuple of numbers.
+inline bool GetNumElements(const std::string& shape, uint64_t& numElements)
+{
+  if (shape.size() < 2 || shape.front() != '(' || shape.back() != ')')
+    return false;
+  numElements = 1;
+  uint64_t dimension = 0;
+  bool inNumber = false;
+  for (size_t i = 1; i < shape.size(); i++)
+  {
+    const char c = shape[i];
+    if (c >= '0' && c <= '9')
+    {
+      dimension = 10 * dimension + (uint64_t)(c - '0');
+      inNumber = true;
+    }
+    else if (c == ',' || c == ')')
+    {
+      if (inNumber)
+        numElements *= dimension;
+      dimension = 0;
+      inNumber = false;
+    }
+    else if (c != ' ')
+      return false;
+  }
+  return true;
+}
+
+template <typename T>
+void Convert(const uint8_t* data, const bool swap, std::vector<float>& weights)
+{
+  for (size_t i = 0; i < weights.size(); i++)
+  {
+    uint8_t bytes[sizeof(T)];
+    std::memcpy(bytes, data + i * sizeof(T), sizeof(T));
+    if (swap)
+    {
+      for (size_t b = 0; b < sizeof(T) / 2; b++)
+        std::swap(bytes[b], bytes[sizeof(T) - 1 - b]);
+    }
+    T value;
+    std::memcpy(&value, bytes, sizeof(T));
+    weights[i] = (float)value;
+  }
+}
+}; // namespace detail
+
+// Throws on failure.
+inline void ReadWeights(const std::filesystem::path& path, std::vector<float>& weights)
+{
+  const MappedFile file(path);
+  const uint8_t* bytes = file.GetData();
+  const size_t size = file.GetSize();
+  const char kMagic[] = "\x93NUMPY";
+  const size_t kMagicSize = sizeof(kMagic) - 1;
+  if (size < kMagicSize + 4 || std::memcmp(bytes, kMagic, kMagicSize) != 0)
+    throw std::runtime_error(path.string() + " isn't a .npy file");
+
+  // Version 1 has a 2-byte header length, and versions 2 and 3 a 4-byte one.
+  const uint8_t majorVersion = bytes[kMagicSize];
+  if (majorVersion < 1 || majorVersion > 3)
+  {
+    throw std::runtime_error(path.string() + " is of .npy version " + std::to_string(majorVersion)
+                             + ", which isn't supported");
+  }
+  const size_t lengthSize = majorVersion == 1 ? 2 : 4;
+  const size_t lengthStart = kMagicSize + 2;
+  if (size < lengthStart + lengthSize)
+    throw std::runtime_error(path.string() + " is cut short");
+  size_t headerSize = 0;
+  for (size_t i = 0; i < lengthSize; i++)
+    headerSize |= (size_t)bytes[lengthStart + i] << (8 * i);
+  const size_t dataStart = lengthStart + lengthSize + headerSize;
+  if (dataStart > size)
+    throw std::runtime_error(path.string() + " is cut short");
+  const std::string header((const char*)bytes + lengthStart + lengthSize, headerSize);
+
+  const std::string descr = detail::GetValue(header, "descr");
+  const bool isFloat = descr == "'<f4'" || descr == "'>f4'";
+  const bool isDouble = descr == "'<f8'" || descr == "'>f8'";
+  if (!isFloat && !isDouble)
+    throw std::runtime_error(path.string() + " has data of type " + descr + " instead of float32 or float64");
+  if (detail::GetValue(header, "fortran_order") != "False")
+    throw std::runtime_error(path.string() + " isn't in C order");
+  uint64_t numElements = 0;
+  if (!detail::GetNumElements(detail::GetValue(header, "shape"), numElements))
+    throw std::runtime_error(path.string() + " has a header that can't be read");
+  const size_t elementSize = isFloat ? 4 : 8;
+  if (numElements > (size - dataStart) / elementSize)
+    throw std::runtime_error(path.string() + " has fewer weights than its header says");
+
+  const bool swap = (descr[1] == '<') != IsLittleEndian();
+  weights.resize((size_t)numElements);
+  if (isFloat && !swap)
+  {
+    if (numElements > 0)
+      std::memcpy(weights.data(), bytes + dataStart, weights.size() * sizeof(float));
+  }
+  else if (isFloat)
+    detail::Convert<float>(bytes + dataStart, swap, weights);
+  else
+    detail::Convert<double>(bytes + dataStart, swap, weights);
+}
+}; // namespace npy
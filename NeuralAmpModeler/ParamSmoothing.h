@@ -0,0 +1,102 @@
+#pragma once
+
+// Parameters that move towards their new value over a short time instead of jumping, so that automation and knob
+// turns don't zipper.
+// The processing chain asks for the ramp in segments that each have a constant step, so that the loops that apply
+// them stay as simple as the unsmoothed ones.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+class SmoothedValue
+{
+public:
+  enum class Shape
+  {
+    // Constant step per sample. For knob positions.
+    Linear,
+    // Constant ratio per sample, i.e. linear in dB. For gains. Jumps instead if either end isn't above 0.
+    Exponential
+  };
+
+  SmoothedValue(const Shape shape = Shape::Linear)
+  : mShape(shape)
+  {
+  }
+
+  // :param rampLength: In samples. 0 jumps.
+  void SetRampLength(const size_t rampLength) { mRampLength = rampLength; };
+  // Starts a ramp if the target moved. The first target is jumped to.
+  void SetTarget(const double target)
+  {
+    if (!mHasValue)
+    {
+      Jump(target);
+      return;
+    }
+    if (target == mTarget)
+      return;
+    mTarget = target;
+    const bool exponential = mShape == Shape::Exponential;
+    if (mRampLength == 0 || (exponential && (mCurrent <= 0.0 || mTarget <= 0.0)))
+    {
+      Jump(target);
+      return;
+    }
+    mRemaining = mRampLength;
+    mStep = exponential ? std::pow(mTarget / mCurrent, 1.0 / (double)mRemaining)
+                        : (mTarget - mCurrent) / (double)mRemaining;
+  };
+  void Jump(const double value)
+  {
+    mCurrent = mTarget = value;
+    mRemaining = 0;
+    mHasValue = true;
+  };
+  bool IsRamping() const { return mRemaining > 0; };
+  double GetCurrent() const { return mCurrent; };
+  double GetTarget() const { return mTarget; };
+
+  // The next stretch of at most maxFrames samples over which the value changes by the same step every sample.
+  // :param start: The value at the first sample
+  // :param step: Added (Linear) or multiplied (Exponential) every sample. 0 or 1 if it's not ramping.
+  // :return: How many samples the stretch lasts. Call Skip() with it afterwards.
+  size_t GetSegment(const size_t maxFrames, double& start, double& step) const
+  {
+    start = mCurrent;
+    if (!IsRamping())
+    {
+      step = mShape == Shape::Exponential ? 1.0 : 0.0;
+      return maxFrames;
+    }
+    step = mStep;
+    return std::min(maxFrames, mRemaining);
+  };
+  // Move along by numFrames samples. Ramps land exactly on their target.
+  void Skip(const size_t numFrames)
+  {
+    if (!IsRamping())
+      return;
+    if (numFrames >= mRemaining)
+    {
+      mCurrent = mTarget;
+      mRemaining = 0;
+      return;
+    }
+    mRemaining -= numFrames;
+    if (mShape == Shape::Exponential)
+      mCurrent *= std::pow(mStep, (double)numFrames);
+    else
+      mCurrent += mStep * (double)numFrames;
+  };
+
+private:
+  const Shape mShape;
+  bool mHasValue = false;
+  double mCurrent = 0.0;
+  double mTarget = 0.0;
+  double mStep = 0.0;
+  size_t mRemaining = 0;
+  size_t mRampLength = 0;
+};
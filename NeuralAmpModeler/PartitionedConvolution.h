@@ -0,0 +1,324 @@
+#pragma once
+
+// Convolution with long IRs, with no latency.
+// * The first taps (the head) are convolved directly, sample by sample.
+// * The rest go through FFTs, in partitions that get bigger further into the IR (non-uniform partitioning). Each
+//   partition's contribution is worked out at the end of a block of its own size, and the layout keeps every
+//   partition at least that far from the start of the IR, so the result is always in time.
+// The layout is picked from the IR's length and the host's block size (see ChooseLayout()). Short IRs are all head.
+// What comes from the IR (the Filter) is kept apart from what comes from the input, so that it can be shared.
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "../AudioDSPTools/dsp/dsp.h"
+
+#include "FFT.h"
+
+namespace dsp
+{
+class PartitionedConvolution
+{
+public:
+  struct Layout
+  {
+    // Taps convolved directly. When there are partitions, it's as long as the smallest of them.
+    size_t headLength = 0;
+    // The FFT partitions after the head. Each stage's partitions are 4 times the size of the last one's, from
+    // minPartitionSize up to maxPartitionSize, which takes the rest of the IR. 0 if it's all head.
+    size_t minPartitionSize = 0;
+    size_t maxPartitionSize = 0;
+
+    bool operator==(const Layout& other) const
+    {
+      return headLength == other.headLength && minPartitionSize == other.minPartitionSize
+             && maxPartitionSize == other.maxPartitionSize;
+    };
+  };
+
+  // IRs up to this long are all head.
+  static constexpr size_t kMaxDirectLength = 128;
+
+  // The head is as long as the smallest partition: small blocks get small partitions, which keeps the head cheap.
+  // The biggest partition is limited by the block size too, since working one out all happens in a single block.
+  static Layout ChooseLayout(const size_t length, const size_t blockSize)
+  {
+    Layout layout;
+    if (length <= kMaxDirectLength)
+    {
+      layout.headLength = length;
+      return layout;
+    }
+    const size_t block = _NextPowerOf2(std::max(blockSize, (size_t)1));
+    const size_t partitionSize = std::min(std::max(block / 4, kMinPartitionSize), kMaxFirstPartitionSize);
+    const size_t largestAllowed = std::min(std::max(block * 16, kMinLargestPartitionSize), kMaxPartitionSize);
+    layout.headLength = partitionSize;
+    layout.minPartitionSize = partitionSize;
+    layout.maxPartitionSize = partitionSize;
+    while (layout.maxPartitionSize * 4 <= largestAllowed)
+      layout.maxPartitionSize *= 4;
+    return layout;
+  };
+
+  // The IR, ready to convolve with: the head's taps and the partitions' spectra.
+  // It doesn't change once it's made, so any number of PartitionedConvolutions can share one (see IRSource.h).
+  class Filter
+  {
+  public:
+    Filter(const float* taps, const size_t length, const Layout& layout)
+    : mLength(length)
+    , mLayout(layout)
+    {
+      const size_t headLength =
+        std::min(layout.minPartitionSize > 0 ? layout.minPartitionSize : layout.headLength, length);
+      mLayout.headLength = headLength;
+      mHead.assign(taps, taps + headLength);
+
+      // Stage i has partitions of size * 4^i and starts at twice that (or right after the head), which keeps its
+      // partitions at least a block of its own from the start. It ends where the next one starts.
+      size_t size = layout.minPartitionSize;
+      size_t start = headLength;
+      while (size > 0 && start < length)
+      {
+        const bool last = size >= layout.maxPartitionSize;
+        const size_t end = last ? length : std::min(length, 8 * size);
+        mStages.emplace_back(taps, length, size, start, end);
+        start = end;
+        size *= 4;
+      }
+    };
+
+    size_t GetLength() const { return mLength; };
+    const Layout& GetLayout() const { return mLayout; };
+    size_t GetNumStages() const { return mStages.size(); };
+
+  private:
+    friend class PartitionedConvolution;
+
+    // Partitions of one size
+    struct Stage
+    {
+      // Covers taps [start, end). start is a multiple of size, and at least size.
+      Stage(const float* taps, const size_t length, const size_t stageSize, const size_t start, const size_t end)
+      : size(stageSize)
+      , firstPartition(start / stageSize)
+      , numPartitions((end - start + stageSize - 1) / stageSize)
+      {
+        RealFFT fft(2 * size);
+        const size_t numBins = fft.GetNumBins();
+        spectra.resize(numPartitions * numBins);
+        std::vector<float> time(2 * size);
+        for (size_t p = 0; p < numPartitions; p++)
+        {
+          const size_t first = start + p * size;
+          const size_t last = std::min(first + size, length);
+          std::fill(time.begin(), time.end(), 0.0f);
+          std::copy(taps + first, taps + last, time.begin());
+          fft.Forward(time.data(), spectra.data() + p * numBins);
+        }
+      }
+
+      size_t size;
+      size_t firstPartition;
+      size_t numPartitions;
+      // One after the other
+      std::vector<RealFFT::Complex> spectra;
+    };
+
+    size_t mLength;
+    Layout mLayout;
+    std::vector<float> mHead;
+    std::vector<Stage> mStages;
+  };
+
+  PartitionedConvolution(const float* taps, const size_t length, const size_t blockSize)
+  : PartitionedConvolution(taps, length, ChooseLayout(length, blockSize))
+  {
+  }
+  PartitionedConvolution(const float* taps, const size_t length, const Layout& layout)
+  : PartitionedConvolution(std::make_shared<const Filter>(taps, length, layout))
+  {
+  }
+  explicit PartitionedConvolution(std::shared_ptr<const Filter> filter)
+  : mFilter(std::move(filter))
+  {
+    const Layout& layout = mFilter->GetLayout();
+    mRunLength = layout.minPartitionSize > 0 ? layout.minPartitionSize : kDirectRunLength;
+    mHeadInput.resize(layout.headLength + mRunLength);
+    mRunOutput.resize(mRunLength);
+    for (const auto& stage : mFilter->mStages)
+      mStages.emplace_back(stage);
+  };
+
+  size_t GetLength() const { return mFilter->GetLength(); };
+  const Layout& GetLayout() const { return mFilter->GetLayout(); };
+  size_t GetNumStages() const { return mStages.size(); };
+  const std::shared_ptr<const Filter>& GetFilter() const { return mFilter; };
+
+  // Forget the input so far
+  void Reset()
+  {
+    std::fill(mHeadInput.begin(), mHeadInput.end(), 0.0f);
+    mPosition = 0;
+    for (auto& stage : mStages)
+      stage.Reset();
+  };
+
+  // In place is fine.
+  void Process(const DSP_SAMPLE* input, DSP_SAMPLE* output, const size_t numFrames)
+  {
+    for (size_t s = 0; s < numFrames;)
+    {
+      // Up to the next boundary of the smallest partitions, which is also one for all of the bigger ones.
+      const size_t length = std::min(numFrames - s, mRunLength - mPosition);
+      _ProcessHead(input + s, length);
+      for (auto& stage : mStages)
+        stage.Process(input + s, mRunOutput.data(), length);
+      for (size_t i = 0; i < length; i++)
+        output[s + i] = (DSP_SAMPLE)mRunOutput[i];
+      mPosition = (mPosition + length) % mRunLength;
+      s += length;
+    }
+  };
+
+private:
+  static constexpr size_t kMinPartitionSize = 32;
+  static constexpr size_t kMaxFirstPartitionSize = 256;
+  static constexpr size_t kMinLargestPartitionSize = 1024;
+  static constexpr size_t kMaxPartitionSize = 8192;
+  // How much of the input an all-head convolution takes at once
+  static constexpr size_t kDirectRunLength = 64;
+
+  static size_t _NextPowerOf2(const size_t n)
+  {
+    size_t p = 1;
+    while (p < n)
+      p *= 2;
+    return p;
+  };
+
+  // Convolves with one of the filter's stages by overlap-save.
+  class Stage
+  {
+  public:
+    explicit Stage(const Filter::Stage& filter)
+    : mFilter(&filter)
+    , mSize(filter.size)
+    , mFFT(2 * filter.size)
+    {
+      const size_t numBins = mFFT.GetNumBins();
+      mTime.resize(2 * mSize);
+      // The partition nearest the start needs the spectrum of the block before last, and so on back from there.
+      mSpectra.resize((filter.firstPartition + filter.numPartitions - 1) * numBins);
+      mAccumulator.resize(numBins);
+      mInput.resize(2 * mSize);
+      mOutput.resize(mSize);
+      Reset();
+    }
+
+    void Reset()
+    {
+      std::fill(mSpectra.begin(), mSpectra.end(), RealFFT::Complex());
+      std::fill(mInput.begin(), mInput.end(), 0.0f);
+      std::fill(mOutput.begin(), mOutput.end(), 0.0f);
+      mNewest = 0;
+      mPosition = 0;
+    };
+
+    // Adds to output. Never goes past the end of a block.
+    void Process(const DSP_SAMPLE* input, float* output, const size_t numFrames)
+    {
+      float* blockInput = mInput.data() + mSize + mPosition;
+      const float* blockOutput = mOutput.data() + mPosition;
+      for (size_t i = 0; i < numFrames; i++)
+      {
+        blockInput[i] = (float)input[i];
+        output[i] += blockOutput[i];
+      }
+      mPosition += numFrames;
+      if (mPosition == mSize)
+      {
+        _EndBlock();
+        mPosition = 0;
+      }
+    };
+
+  private:
+    // Works out the output for the next block.
+    void _EndBlock()
+    {
+      const size_t numBins = mFFT.GetNumBins();
+      const size_t numSpectra = mSpectra.size() / numBins;
+      mNewest = (mNewest + 1) % numSpectra;
+      mFFT.Forward(mInput.data(), mSpectra.data() + mNewest * numBins);
+      std::copy(mInput.begin() + mSize, mInput.end(), mInput.begin());
+
+      // Partition j (counting from the start of the IR) contributes the input from j blocks before the next one,
+      // i.e. j - 1 before the one that just ended.
+      std::fill(mAccumulator.begin(), mAccumulator.end(), RealFFT::Complex());
+      RealFFT::Complex* accumulator = mAccumulator.data();
+      for (size_t p = 0; p < mFilter->numPartitions; p++)
+      {
+        const size_t age = mFilter->firstPartition + p - 1;
+        const size_t slot = (mNewest + numSpectra - age) % numSpectra;
+        const RealFFT::Complex* spectrum = mSpectra.data() + slot * numBins;
+        const RealFFT::Complex* filter = mFilter->spectra.data() + p * numBins;
+        for (size_t k = 0; k < numBins; k++)
+          accumulator[k] += RealFFT::Multiply(spectrum[k], filter[k]);
+      }
+      mFFT.Inverse(accumulator, mTime.data());
+      // The first half wrapped around.
+      std::copy(mTime.begin() + mSize, mTime.end(), mOutput.begin());
+    };
+
+    // Belongs to the Filter that the PartitionedConvolution holds on to
+    const Filter::Stage* mFilter;
+    size_t mSize;
+    RealFFT mFFT;
+    // Spectra of the input, a block apart. A ring, with the newest at mNewest.
+    std::vector<RealFFT::Complex> mSpectra;
+    size_t mNewest = 0;
+    std::vector<RealFFT::Complex> mAccumulator;
+    // The last block and the one coming in
+    std::vector<float> mInput;
+    // For the block coming in
+    std::vector<float> mOutput;
+    std::vector<float> mTime;
+    size_t mPosition = 0;
+  };
+
+  // Writes the head's output to mRunOutput.
+  void _ProcessHead(const DSP_SAMPLE* input, const size_t numFrames)
+  {
+    const std::vector<float>& head = mFilter->mHead;
+    const size_t headLength = head.size();
+    std::fill(mRunOutput.begin(), mRunOutput.begin() + numFrames, 0.0f);
+    if (headLength == 0)
+      return;
+    // mHeadInput is the headLength - 1 samples before this, then this.
+    float* newInput = mHeadInput.data() + headLength - 1;
+    for (size_t i = 0; i < numFrames; i++)
+      newInput[i] = (float)input[i];
+    // One tap at a time over the whole run, so that the inner loop vectorizes.
+    float* output = mRunOutput.data();
+    for (size_t m = 0; m < headLength; m++)
+    {
+      const float tap = head[m];
+      const float* x = newInput - m;
+      for (size_t i = 0; i < numFrames; i++)
+        output[i] += tap * x[i];
+    }
+    std::copy(mHeadInput.begin() + numFrames, mHeadInput.begin() + numFrames + headLength - 1, mHeadInput.begin());
+  };
+
+  std::shared_ptr<const Filter> mFilter;
+  std::vector<float> mHeadInput;
+  std::vector<float> mRunOutput;
+  size_t mRunLength = 0;
+  // Where we are in the smallest partition's block
+  size_t mPosition = 0;
+  std::vector<Stage> mStages;
+};
+}; // namespace dsp
@@ -0,0 +1,97 @@
+#pragma once
+
+// Everything that comes after the model, in one loop over the block: the noise gate's gain, the tone stack's
+// biquads, the DC blocker, and the output gain. Each sample goes through the whole cascade while it's in a register
+// instead of every filter making its own pass over its own buffer.
+
+#include <array>
+#include <cstddef>
+
+#include "../AudioDSPTools/dsp/dsp.h"
+
+#include "Biquad.h"
+
+class PostModelFilters
+{
+public:
+  // Enough for BasicNamToneStack with room to spare
+  static constexpr size_t kMaxBiquads = 4;
+
+  // Biquads run in order, then the high-pass.
+  // Changing the coefficients keeps the filters' state, like AudioDSPTools' SetParams().
+  void SetBiquads(const dsp::biquad::Coefficients* coefficients, const size_t numBiquads)
+  {
+    mNumBiquads = numBiquads < kMaxBiquads ? numBiquads : kMaxBiquads;
+    for (size_t i = 0; i < mNumBiquads; i++)
+      mBiquads[i] = coefficients[i];
+  };
+  void SetHighPass(const dsp::biquad::Coefficients& coefficients) { mHighPass = coefficients; };
+  size_t GetNumBiquads() const { return mNumBiquads; };
+
+  // Silence the filters' memory
+  void Reset()
+  {
+    mBiquadStates.fill(dsp::biquad::State());
+    mHighPassState = dsp::biquad::State();
+  };
+
+  // output = gain * highPass(biquads(gateGain * input)). In place is fine.
+  // :param gainRatio: The gain is multiplied by this after every sample (see SmoothedValue).
+  // :param gateGain: Per sample (see BlockNoiseGate). Null if there isn't any.
+  void Process(const DSP_SAMPLE* input, DSP_SAMPLE* output, const size_t numFrames, const double gain,
+               const double gainRatio = 1.0, const DSP_SAMPLE* gateGain = nullptr)
+  {
+    if (gateGain != nullptr)
+      _Dispatch<true>(input, output, numFrames, gain, gainRatio, gateGain);
+    else
+      _Dispatch<false>(input, output, numFrames, gain, gainRatio, gateGain);
+  };
+
+private:
+  // Unrolled for each length of cascade
+  template <bool Gated>
+  void _Dispatch(const DSP_SAMPLE* input, DSP_SAMPLE* output, const size_t numFrames, const double gain,
+                 const double gainRatio, const DSP_SAMPLE* gateGain)
+  {
+    switch (mNumBiquads)
+    {
+      case 0: _Process<0, Gated>(input, output, numFrames, gain, gainRatio, gateGain); break;
+      case 1: _Process<1, Gated>(input, output, numFrames, gain, gainRatio, gateGain); break;
+      case 2: _Process<2, Gated>(input, output, numFrames, gain, gainRatio, gateGain); break;
+      case 3: _Process<3, Gated>(input, output, numFrames, gain, gainRatio, gateGain); break;
+      default: _Process<kMaxBiquads, Gated>(input, output, numFrames, gain, gainRatio, gateGain); break;
+    }
+  };
+
+  template <size_t NumBiquads, bool Gated>
+  void _Process(const DSP_SAMPLE* input, DSP_SAMPLE* output, const size_t numFrames, double gain,
+                const double gainRatio, const DSP_SAMPLE* gateGain)
+  {
+    // Local copies so that the compiler can keep them in registers
+    std::array<dsp::biquad::Coefficients, kMaxBiquads> coefficients = mBiquads;
+    std::array<dsp::biquad::State, kMaxBiquads> states = mBiquadStates;
+    const dsp::biquad::Coefficients highPass = mHighPass;
+    dsp::biquad::State highPassState = mHighPassState;
+
+    for (size_t s = 0; s < numFrames; s++)
+    {
+      double x = input[s];
+      if (Gated)
+        x *= gateGain[s];
+      for (size_t i = 0; i < NumBiquads; i++)
+        x = states[i].Process(coefficients[i], x);
+      x = highPassState.Process(highPass, x);
+      output[s] = (DSP_SAMPLE)(gain * x);
+      gain *= gainRatio;
+    }
+
+    mBiquadStates = states;
+    mHighPassState = highPassState;
+  };
+
+  size_t mNumBiquads = 0;
+  std::array<dsp::biquad::Coefficients, kMaxBiquads> mBiquads;
+  std::array<dsp::biquad::State, kMaxBiquads> mBiquadStates;
+  dsp::biquad::Coefficients mHighPass;
+  dsp::biquad::State mHighPassState;
+};
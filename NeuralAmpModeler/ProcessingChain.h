@@ -0,0 +1,694 @@
+#pragma once
+
+#include <algorithm> // std::copy, std::min, std::max, std::all_of, std::minmax_element
+#include <array>
+#include <cfenv>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <new> // std::align_val_t
+#include <sstream>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "../AudioDSPTools/dsp/dsp.h"
+
+#include "BlockNoiseGate.h"
+#include "ConvolutionIR.h"
+#include "ParamSmoothing.h"
+#include "PostModelFilters.h"
+#include "ResamplingNAM.h"
+#include "SIMDKernels.h"
+#include "ToneStack.h"
+#include "architecture.hpp"
+
+// Precision: everything runs in DSP_SAMPLE, which is double unless DSP_SAMPLE_FLOAT is defined. Define
+// NAM_SAMPLE_FLOAT along with it (and SAMPLE_TYPE_FLOAT for iPlug2) so that the whole chain is single precision with
+// no conversions in between.
+static_assert(std::is_same<DSP_SAMPLE, NAM_SAMPLE>::value,
+              "The model and the rest of the chain need the same sample type; define both or neither of "
+              "NAM_SAMPLE_FLOAT and DSP_SAMPLE_FLOAT.");
+
+// The plugin is mono inside
+constexpr size_t kNumChannelsInternal = 1;
+// Cutoff of the HPF for DC offset (Issue 271)
+const double kDCBlockerFrequency = 5.0;
+// How long switching models or IRs takes by default (seconds)
+const double kDefaultCrossfadeTime = 0.05;
+// Until Reset() says otherwise (iPlug2's default)
+const int kDefaultMaxBlockSize = 512;
+// Noise gate timing (seconds), as it's always been
+const double kDefaultNoiseGateOpenTime = 0.005;
+const double kDefaultNoiseGateHoldTime = 0.01;
+const double kDefaultNoiseGateCloseTime = 0.05;
+// How long the gains and tone stack knobs take to get to a new value (seconds)
+const double kParamSmoothingTime = 0.02;
+// While a tone stack knob is moving, its filters are updated this often (samples)
+constexpr size_t kToneStackSubBlockSize = 32;
+constexpr size_t kNumToneStackParams = (size_t)dsp::tone_stack::Param::NumParams;
+// Skipping the model (see BlockSettings::idleModel):
+// Input at or below this is silence (a 24-bit LSB).
+const double kModelIdleSilenceLevel = 1.0 / 16777216.0;
+// How long the input has to be silent before the model's output is checked for having settled (seconds). Enough for
+// a WaveNet's receptive field and for an LSTM's state to decay.
+const double kModelIdleDrainTime = 0.5;
+// How far the model's output can move over a block and still count as settled
+const double kModelIdleSettledTolerance = 1.0e-7;
+// The tail is over once the DC blocker has decayed this far (-120 dB).
+const double kTailDecayLevel = 1.0e-6;
+
+// The audio path of the plugin: everything that ProcessBlock() does that doesn't need iPlug2.
+// The plugin owns the model and IR (and the staging that goes with them) and hands them in every block; this
+// owns the buffers and the stateful modules around them.
+// Keeping this free of iPlug2 lets the offline tools in tools/ run exactly the same chain as the plugin.
+class ProcessingChain
+{
+public:
+  // What the plugin reads from its parameters once per block
+  // The gains and the tone stack knobs are targets: the chain ramps there from where the last block left off.
+  struct BlockSettings
+  {
+    double inputGain = 1.0;
+    double outputGain = 1.0;
+    // False jumps to the new gains, e.g. when a model swap's crossfade already takes care of the change.
+    bool smoothGains = true;
+    bool noiseGateActive = true;
+    double noiseGateThreshold = -80.0;
+    // Seconds
+    double noiseGateOpenTime = kDefaultNoiseGateOpenTime;
+    double noiseGateHoldTime = kDefaultNoiseGateHoldTime;
+    double noiseGateCloseTime = kDefaultNoiseGateCloseTime;
+    bool toneStackActive = true;
+    // Knob positions, indexed by dsp::tone_stack::Param
+    std::array<double, kNumToneStackParams> toneStackValues{5.0, 5.0, 5.0};
+    // Applied to the outgoing model during a crossfade so that differences in output gain (e.g. from normalization)
+    // are faded too instead of jumping.
+    double outgoingModelGain = 1.0;
+    // Skip the model while it can't make a difference: once it's settled on silent input.
+    bool idleModel = true;
+  };
+
+  ProcessingChain()
+  {
+    _InitToneStack();
+    for (auto& gate : mNoiseGates)
+      gate.SetSampleRate(mSampleRate);
+    mPostModelFilters.SetHighPass(dsp::biquad::Coefficients::HighPass(mSampleRate, kDCBlockerFrequency));
+    mModelDrainFrames = (size_t)(kModelIdleDrainTime * mSampleRate);
+    _AllocateArena(kDefaultMaxBlockSize);
+  };
+  // The trigger holds a pointer to our gain.
+  ProcessingChain(const ProcessingChain&) = delete;
+  ProcessingChain& operator=(const ProcessingChain&) = delete;
+
+  // Call from OnReset()
+  // This is the only place where the chain's own buffers are allocated. Process() doesn't allocate for blocks of up
+  // to maxBlockSize frames and refuses bigger ones, so callers split those up.
+  void Reset(const double sampleRate, const int maxBlockSize)
+  {
+    mSampleRate = sampleRate;
+    for (auto& gate : mNoiseGates)
+      gate.SetSampleRate(sampleRate);
+    mToneStack->Reset(sampleRate, maxBlockSize);
+    mPostModelFilters.SetHighPass(dsp::biquad::Coefficients::HighPass(sampleRate, kDCBlockerFrequency));
+    mPostModelFilters.Reset();
+    const size_t rampLength = (size_t)(kParamSmoothingTime * sampleRate);
+    mInputGain.SetRampLength(rampLength);
+    mOutputGain.SetRampLength(rampLength);
+    for (auto& value : mToneStackValues)
+      value.SetRampLength(rampLength);
+    // (The model is reset along with us.)
+    mModelDrainFrames = (size_t)(kModelIdleDrainTime * sampleRate);
+    _ResetModelIdle();
+    _AllocateArena((size_t)std::max(maxBlockSize, 1));
+  };
+  size_t GetMaxBlockSize() const { return mMaxBlockSize; };
+
+  // Switching models and IRs.
+  // After a swap, call Start*Crossfade() and keep passing the old module to Process() as the outgoing one until
+  // Is*Crossfading() is false.
+  // 0 switches instantly.
+  void SetCrossfadeTime(const double seconds) { mCrossfadeTime = seconds; };
+  // Returns false if crossfades are off, in which case the outgoing module can go right away.
+  bool StartModelCrossfade()
+  {
+    _ResetModelIdle();
+    return mModelCrossfade.Start(_GetCrossfadeLength());
+  };
+  bool StartIRCrossfade() { return mIRCrossfade.Start(_GetCrossfadeLength()); };
+  bool IsModelCrossfading() const { return mModelCrossfade.IsActive(); };
+  bool IsIRCrossfading() const { return mIRCrossfade.IsActive(); };
+  // Jumps to the end of any crossfades, after which the outgoing modules aren't needed anymore.
+  // E.g. on a reset, since they were made for the old settings.
+  void EndCrossfades()
+  {
+    mModelCrossfade.End();
+    mIRCrossfade.End();
+  };
+
+  // The whole thing.
+  // :param model: May be null, in which case the input is passed through.
+  // :param ir: May be null (no IR, or the IR is toggled off).
+  // :param outgoingModel: What's being crossfaded from (see StartModelCrossfade()). Null means the input.
+  // :param outgoingIR: Same, for the IR.
+  void Process(DSP_SAMPLE** inputs, DSP_SAMPLE** outputs, const size_t numChannelsIn, const size_t numChannelsOut,
+               const size_t numFrames, ResamplingNAM* model, ConvolutionIR* ir, const BlockSettings& settings,
+               ResamplingNAM* outgoingModel = nullptr, ConvolutionIR* outgoingIR = nullptr)
+  {
+    const size_t numChannelsInternal = kNumChannelsInternal;
+
+    // Disable floating point denormals
+    std::fenv_t fe_state;
+    std::feholdexcept(&fe_state);
+    disable_denormals();
+
+    PrepareBuffers(numChannelsInternal, numFrames);
+    // Input is collapsed to mono in preparation for the NAM.
+    ProcessInput(inputs, numFrames, numChannelsIn, numChannelsInternal, settings.inputGain, settings.smoothGains);
+
+    // Noise gate: listens to the input, but its gain goes on after the NAM (with the other filters).
+    DSP_SAMPLE** gateGains = nullptr;
+    if (settings.noiseGateActive)
+      gateGains = ProcessNoiseGate(GetInputPointers(), numChannelsInternal, numFrames, settings);
+
+    if (settings.idleModel && !mModelCrossfade.IsActive())
+      _ProcessModelOrIdle(model, numFrames);
+    else
+      ProcessModel(model, GetInputPointers(), numChannelsInternal, numFrames);
+    if (mModelCrossfade.IsActive())
+    {
+      // The outgoing one has to keep going with the same input until it's out.
+      _RunModel(outgoingModel, GetInputPointers(), mCrossfadePointers.data(), numChannelsInternal, numFrames);
+      mModelCrossfade.Process(mCrossfadePointers.data(), GetOutputPointers(), numChannelsInternal, numFrames,
+                              settings.outgoingModelGain);
+    }
+    // Noise gate, tone stack, DC blocker, and output level. The last three (and the IR) are all linear, so the IR
+    // can go after them.
+    DSP_SAMPLE** filterPointers =
+      ProcessPostModelFilters(GetOutputPointers(), numChannelsInternal, numFrames, settings, gateGains);
+
+    DSP_SAMPLE** irPointers = filterPointers;
+    if (ir != nullptr)
+      irPointers = ProcessIR(ir, filterPointers, numChannelsInternal, numFrames);
+    if (mIRCrossfade.IsActive())
+    {
+      // The IRs own their outputs (or share mIRPointers), so mix into our own buffer, before the outgoing one runs.
+      for (size_t c = 0; c < numChannelsInternal; c++)
+        std::copy(irPointers[c], irPointers[c] + numFrames, mCrossfadePointers[c]);
+      DSP_SAMPLE** outgoingPointers = filterPointers;
+      if (outgoingIR != nullptr)
+        outgoingPointers = ProcessIR(outgoingIR, filterPointers, numChannelsInternal, numFrames);
+      mIRCrossfade.Process(outgoingPointers, mCrossfadePointers.data(), numChannelsInternal, numFrames, 1.0);
+      irPointers = mCrossfadePointers.data();
+    }
+
+    // restore previous floating point state
+    std::feupdateenv(&fe_state);
+
+    // Let's get outta here
+    // This is where we exit mono for whatever the output requires.
+    // (The output level was applied with the filters.)
+    ProcessOutput(irPointers, outputs, numFrames, numChannelsInternal, numChannelsOut, 1.0);
+  };
+
+  // The stages, in the order that Process() runs them.
+  // They're public so that the benchmarks can time them one at a time.
+
+  // Check that the block fits the buffers from Reset(). (Nothing is allocated here anymore.)
+  void PrepareBuffers(const size_t numChannels, const size_t numFrames)
+  {
+    if (numChannels != kNumChannelsInternal)
+    {
+      std::stringstream ss;
+      ss << "Expected " << kNumChannelsInternal << " internal channels, but got " << numChannels << "!";
+      throw std::runtime_error(ss.str());
+    }
+    if (numFrames > mMaxBlockSize)
+    {
+      std::stringstream ss;
+      ss << "Block of " << numFrames << " frames is bigger than the maximum of " << mMaxBlockSize
+         << " given to Reset()!";
+      throw std::runtime_error(ss.str());
+    }
+  };
+
+  // Copy the input buffer to the object, applying input level.
+  // :param nChansIn: In from external
+  // :param nChansOut: Out to the internal of the DSP routine
+  // :param smooth: Ramp to inputGain (see BlockSettings)
+  void ProcessInput(DSP_SAMPLE** inputs, const size_t nFrames, const size_t nChansIn, const size_t nChansOut,
+                    const double inputGain, const bool smooth = true)
+  {
+    // We'll assume that the main processing is mono for now. We'll handle dual amps later.
+    if (nChansOut != 1)
+    {
+      std::stringstream ss;
+      ss << "Expected mono output, but " << nChansOut << " output channels are requested!";
+      throw std::runtime_error(ss.str());
+    }
+
+    // On the standalone, we can probably assume that the user has plugged into only one input and they expect it to
+    // be carried straight through. Don't apply any division over nChansIn because we're just "catching anything out
+    // there." However, in a DAW, it's probably something providing stereo, and we want to take the average in order
+    // to avoid doubling the loudness. (This would change w/ double mono processing)
+    double gain = inputGain;
+#ifndef APP_API
+    gain /= (float)nChansIn;
+#endif
+    if (smooth)
+      mInputGain.SetTarget(gain);
+    else
+      mInputGain.Jump(gain);
+    // Assume PrepareBuffers() was already called
+    if (!mInputGain.IsRamping())
+    {
+      simd_kernels::DownmixWithGain(inputs, nChansIn, nFrames, (DSP_SAMPLE)mInputGain.GetCurrent(), mInputPointers[0]);
+      return;
+    }
+    for (size_t s = 0; s < nFrames;)
+    {
+      double start, ratio;
+      const size_t length = mInputGain.GetSegment(nFrames - s, start, ratio);
+      simd_kernels::DownmixWithGainRamp(
+        inputs, nChansIn, s, s + length, (DSP_SAMPLE)start, (DSP_SAMPLE)ratio, mInputPointers[0]);
+      mInputGain.Skip(length);
+      s += length;
+    }
+  };
+
+  // Works out the noise gate's gain for the block from the input.
+  // :return: The gain for each sample, for ProcessPostModelFilters(). Null if the gate is open for the whole block.
+  // The gate is only reconfigured when its settings change (and its sample rate only in Reset()).
+  DSP_SAMPLE** ProcessNoiseGate(DSP_SAMPLE** inputs, const size_t numChannels, const size_t numFrames,
+                                const BlockSettings& settings)
+  {
+    const NoiseGateSettings gateSettings{settings.noiseGateThreshold, settings.noiseGateOpenTime,
+                                         settings.noiseGateHoldTime, settings.noiseGateCloseTime};
+    if (!mNoiseGateConfigured || gateSettings != mNoiseGateSettings)
+    {
+      BlockNoiseGate::Params params;
+      params.time = 0.01;
+      params.threshold = gateSettings.threshold;
+      params.ratio = 0.1; // Quadratic...
+      params.openTime = gateSettings.openTime;
+      params.holdTime = gateSettings.holdTime;
+      params.closeTime = gateSettings.closeTime;
+      for (auto& gate : mNoiseGates)
+        gate.SetParams(params);
+      mNoiseGateSettings = gateSettings;
+      mNoiseGateConfigured = true;
+    }
+    std::array<bool, kNumChannelsInternal> wroteGain{};
+    bool anyGain = false;
+    for (size_t c = 0; c < numChannels; c++)
+    {
+      wroteGain[c] = mNoiseGates[c].Process(inputs[c], mGateGainPointers[c], numFrames);
+      anyGain = anyGain || wroteGain[c];
+    }
+    if (!anyGain)
+      return nullptr;
+    // Channels that are open still need their (unit) gain written out if any other one isn't.
+    for (size_t c = 0; c < numChannels; c++)
+      if (!wroteGain[c])
+        std::fill(mGateGainPointers[c], mGateGainPointers[c] + numFrames, (DSP_SAMPLE)1.0);
+    return mGateGainPointers.data();
+  };
+
+  // Writes to the output buffer
+  void ProcessModel(ResamplingNAM* model, DSP_SAMPLE** inputs, const size_t numChannels, const size_t numFrames)
+  {
+    _RunModel(model, inputs, GetOutputPointers(), numChannels, numFrames);
+  };
+
+  // The noise gate's gain, the tone stack (if it's active), the DC blocker, and the output gain in one pass.
+  // While the tone stack's knobs are moving, the block is split up so that its filters follow them.
+  // Tone stacks that can't be expressed as biquads run on their own first, with the knobs where they end up.
+  // :param gateGains: From ProcessNoiseGate(). Null for none.
+  DSP_SAMPLE** ProcessPostModelFilters(DSP_SAMPLE** inputs, const size_t numChannels, const size_t numFrames,
+                                       const BlockSettings& settings, DSP_SAMPLE** gateGains = nullptr)
+  {
+    if (settings.smoothGains)
+      mOutputGain.SetTarget(settings.outputGain);
+    else
+      mOutputGain.Jump(settings.outputGain);
+    bool toneStackRamping = false;
+    for (size_t i = 0; i < kNumToneStackParams; i++)
+    {
+      mToneStackValues[i].SetTarget(settings.toneStackValues[i]);
+      toneStackRamping = toneStackRamping || mToneStackValues[i].IsRamping();
+    }
+
+    bool toneStackActive = settings.toneStackActive && mToneStack != nullptr;
+    // (If it's off, the knobs can catch up in one go.)
+    toneStackRamping = toneStackRamping && toneStackActive;
+    std::array<dsp::biquad::Coefficients, PostModelFilters::kMaxBiquads> biquads;
+    if (toneStackActive && mToneStack->GetBiquads(biquads.data(), biquads.size()) == 0)
+    {
+      // The gate goes first.
+      if (gateGains != nullptr)
+      {
+        for (size_t c = 0; c < numChannels; c++)
+          for (size_t s = 0; s < numFrames; s++)
+            inputs[c][s] *= gateGains[c][s];
+        gateGains = nullptr;
+      }
+      _SkipToneStackValues(numFrames);
+      inputs = mToneStack->Process(inputs, (int)numChannels, (int)numFrames);
+      toneStackActive = false;
+      toneStackRamping = false;
+    }
+
+    for (size_t s = 0; s < numFrames;)
+    {
+      size_t length = toneStackRamping ? std::min(numFrames - s, kToneStackSubBlockSize) : numFrames - s;
+      double gain, gainRatio;
+      length = mOutputGain.GetSegment(length, gain, gainRatio);
+      // The filters for this piece are where the knobs are at its end, so that ramps finish on their targets.
+      _SkipToneStackValues(length);
+      const size_t numBiquads = toneStackActive ? mToneStack->GetBiquads(biquads.data(), biquads.size()) : 0;
+      mPostModelFilters.SetBiquads(biquads.data(), numBiquads);
+      for (size_t c = 0; c < numChannels; c++)
+        mPostModelFilters.Process(inputs[c] + s, mFilterPointers[c] + s, length, gain, gainRatio,
+                                  gateGains != nullptr ? gateGains[c] + s : nullptr);
+      mOutputGain.Skip(length);
+      s += length;
+    }
+    return mFilterPointers.data();
+  };
+
+  DSP_SAMPLE** ProcessIR(ConvolutionIR* ir, DSP_SAMPLE** inputs, const size_t numChannels, const size_t numFrames)
+  {
+    const size_t irBlockSize = (size_t)ir->GetMaxBlockSize();
+    if (numFrames <= irBlockSize)
+      return ir->Process(inputs, numChannels, numFrames);
+    // The host's blocks got bigger, and the IR for them is still on its way from the loader. Until then, this one
+    // takes them a piece at a time.
+    std::array<DSP_SAMPLE*, kNumChannelsInternal> pieces{};
+    for (size_t s = 0; s < numFrames; s += irBlockSize)
+    {
+      const size_t length = std::min(irBlockSize, numFrames - s);
+      for (size_t c = 0; c < numChannels; c++)
+        pieces[c] = inputs[c] + s;
+      DSP_SAMPLE** outputs = ir->Process(pieces.data(), numChannels, length);
+      for (size_t c = 0; c < numChannels; c++)
+        std::copy(outputs[c], outputs[c] + length, mIRPointers[c] + s);
+    }
+    return mIRPointers.data();
+  };
+
+  // Copy the output to the output buffer, applying output level.
+  // :param nChansIn: In from internal
+  // :param nChansOut: Out to external
+  void ProcessOutput(DSP_SAMPLE** inputs, DSP_SAMPLE** outputs, const size_t nFrames, const size_t nChansIn,
+                     const size_t nChansOut, const double outputGain)
+  {
+    const double gain = outputGain;
+    // Assume PrepareBuffers() was already called
+    if (nChansIn != 1)
+      throw std::runtime_error("Plugin is supposed to process in mono.");
+#ifdef APP_API // Ensure valid output to interface
+    const bool clamp = true;
+#else // In a DAW, other things may come next and should be able to handle large
+      // values.
+    const bool clamp = false;
+#endif
+    // Broadcast the internal mono stream to all output channels.
+    const size_t cin = 0;
+    simd_kernels::BroadcastWithGain(inputs[cin], outputs, nChansOut, nFrames, (DSP_SAMPLE)gain, clamp);
+  };
+
+  // How long the output keeps going after the input stops (samples), so that hosts can stop processing silent tracks
+  // once it's over. Everything is taken to ring one after the other, which is the most it could be.
+  // :param model: May be null.
+  // :param irLength: Samples. 0 if there's no IR.
+  size_t GetTailSize(const ResamplingNAM* model, const size_t irLength) const
+  {
+    size_t tail = irLength;
+    if (model != nullptr)
+      tail += (size_t)std::max(model->GetTailSize(), 0);
+    // The DC blocker decays exponentially. (The tone stack's filters settle much sooner, so they're covered by it.)
+    const double pole = -dsp::biquad::Coefficients::HighPass(mSampleRate, kDCBlockerFrequency).a1;
+    tail += (size_t)std::ceil(std::log(kTailDecayLevel) / std::log(pole));
+    return tail;
+  };
+
+  // Output of input leveling, for the meters
+  DSP_SAMPLE** GetInputPointers() { return mInputPointers.data(); };
+  // Where the model writes
+  DSP_SAMPLE** GetOutputPointers() { return mOutputPointers.data(); };
+  dsp::tone_stack::AbstractToneStack* GetToneStack() { return mToneStack.get(); };
+
+  // Gains (in dB) implied by the level knobs, the calibration settings, and the model's metadata.
+  // :param outputMode: 0 is "Raw", 1 is "Normalized", 2 is "Calibrated" (see kOutputMode)
+  static double GetInputGainDB(ResamplingNAM* model, const double inputLevelDB, const bool calibrateInput,
+                               const double inputCalibrationLevel)
+  {
+    double inputGainDB = inputLevelDB;
+    // Input calibration
+    if ((model != nullptr) && (model->HasInputLevel()) && calibrateInput)
+    {
+      inputGainDB += inputCalibrationLevel - model->GetInputLevel();
+    }
+    return inputGainDB;
+  };
+  static double GetOutputGainDB(ResamplingNAM* model, const double outputLevelDB, const int outputMode,
+                                const double inputCalibrationLevel)
+  {
+    double gainDB = outputLevelDB;
+    if (model != nullptr)
+    {
+      switch (outputMode)
+      {
+        case 1: // Normalized
+          if (model->HasLoudness())
+          {
+            const double loudness = model->GetLoudness();
+            const double targetLoudness = -18.0;
+            gainDB += (targetLoudness - loudness);
+          }
+          break;
+        case 2: // Calibrated
+          if (model->HasOutputLevel())
+          {
+            const double inputLevel = inputCalibrationLevel;
+            const double outputLevel = model->GetOutputLevel();
+            gainDB += (outputLevel - inputLevel);
+          }
+          break;
+        case 0: // Raw
+        default: break;
+      }
+    }
+    return gainDB;
+  };
+
+private:
+  // Goes from the outgoing signal to the incoming one along a raised cosine, which keeps correlated signals (the
+  // same input through similar amps) at a steady level.
+  class Crossfade
+  {
+  public:
+    bool Start(const size_t length)
+    {
+      mPosition = 0;
+      mLength = length;
+      return IsActive();
+    };
+    bool IsActive() const { return mPosition < mLength; };
+    void End() { mPosition = mLength; };
+    // Mixes outgoing into incoming, in place.
+    void Process(DSP_SAMPLE** outgoing, DSP_SAMPLE** incoming, const size_t numChannels, const size_t numFrames,
+                 const double outgoingGain)
+    {
+      const double halfPi = 0.5 * MATH_PI;
+      for (size_t s = 0; s < numFrames; s++)
+      {
+        const size_t position = std::min(mPosition + s, mLength);
+        const double fadeIn = std::pow(std::sin(halfPi * (double)position / (double)mLength), 2);
+        const double fadeOut = outgoingGain * (1.0 - fadeIn);
+        for (size_t c = 0; c < numChannels; c++)
+          incoming[c][s] = fadeIn * incoming[c][s] + fadeOut * outgoing[c][s];
+      }
+      mPosition = std::min(mPosition + numFrames, mLength);
+    };
+
+  private:
+    size_t mPosition = 0;
+    size_t mLength = 0;
+  };
+
+  // Runs the model, or copies the input if there isn't one.
+  void _RunModel(ResamplingNAM* model, DSP_SAMPLE** inputs, DSP_SAMPLE** outputs, const size_t numChannels,
+                 const size_t numFrames)
+  {
+    if (model != nullptr)
+    {
+      model->process(inputs, outputs, (int)numFrames);
+    }
+    else
+    {
+      _FallbackDSP(inputs, outputs, numChannels, numFrames);
+    }
+  };
+  // Runs the model, unless it's had silence for long enough that its output has stopped moving. That's where it
+  // would stay, so it's held. Its state is already what silence would leave it at, so it picks up again exactly as
+  // if it had been running all along.
+  // (Skipping it while the noise gate is shut isn't done: with sound going in, its state would fall behind, and
+  // catching up would mean running it over its whole receptive field, or forever for an LSTM.)
+  void _ProcessModelOrIdle(ResamplingNAM* model, const size_t numFrames)
+  {
+    const DSP_SAMPLE* input = mInputPointers[0];
+    DSP_SAMPLE* output = mOutputPointers[0];
+    if (model == nullptr || numFrames == 0)
+    {
+      ProcessModel(model, mInputPointers.data(), kNumChannelsInternal, numFrames);
+      return;
+    }
+    // Outside of crossfades, a new model can only get here by Reset(), so this is belt and braces.
+    if (model != mIdleModel)
+    {
+      _ResetModelIdle();
+      mIdleModel = model;
+    }
+    const DSP_SAMPLE silenceLevel = (DSP_SAMPLE)kModelIdleSilenceLevel;
+    const bool silent =
+      std::all_of(input, input + numFrames, [silenceLevel](const DSP_SAMPLE x) { return std::abs(x) <= silenceLevel; });
+    mSilentFrames = silent ? std::min(mSilentFrames + numFrames, mModelDrainFrames) : 0;
+
+    if (mModelSettled && silent)
+    {
+      std::fill(output, output + numFrames, mHeldModelOutput);
+      return;
+    }
+    ProcessModel(model, mInputPointers.data(), kNumChannelsInternal, numFrames);
+    mHeldModelOutput = output[numFrames - 1];
+    mModelSettled = false;
+    if (mSilentFrames >= mModelDrainFrames)
+    {
+      const auto range = std::minmax_element(output, output + numFrames);
+      mModelSettled = (double)*range.second - (double)*range.first <= kModelIdleSettledTolerance;
+    }
+  };
+  void _ResetModelIdle()
+  {
+    mIdleModel = nullptr;
+    mSilentFrames = 0;
+    mModelSettled = false;
+    mHeldModelOutput = (DSP_SAMPLE)0.0;
+  };
+  // Moves the tone stack knobs along their ramps and hands any that moved to the tone stack.
+  void _SkipToneStackValues(const size_t numFrames)
+  {
+    for (size_t i = 0; i < kNumToneStackParams; i++)
+    {
+      mToneStackValues[i].Skip(numFrames);
+      const double value = mToneStackValues[i].GetCurrent();
+      if (value != mAppliedToneStackValues[i] && mToneStack != nullptr)
+      {
+        mToneStack->SetParam((dsp::tone_stack::Param)i, value);
+        mAppliedToneStackValues[i] = value;
+      }
+    }
+  };
+  size_t _GetCrossfadeLength() const { return (size_t)std::max(0.0, mCrossfadeTime * mSampleRate); };
+  // One 64-byte-aligned block holding every buffer, with each channel starting on its own cache line.
+  void _AllocateArena(const size_t maxBlockSize)
+  {
+    if (mArena != nullptr && maxBlockSize == mMaxBlockSize)
+      return;
+    const size_t samplesPerLine = kArenaAlignment / sizeof(DSP_SAMPLE);
+    const size_t stride = (maxBlockSize + samplesPerLine - 1) / samplesPerLine * samplesPerLine;
+    const size_t arenaSize = kNumArenaBuffers * kNumChannelsInternal * stride;
+    mArena.reset(new (std::align_val_t(kArenaAlignment)) DSP_SAMPLE[arenaSize]());
+    mMaxBlockSize = maxBlockSize;
+
+    std::array<DSP_SAMPLE*, kNumChannelsInternal>* buffers[kNumArenaBuffers] = {
+      &mInputPointers, &mOutputPointers, &mCrossfadePointers, &mFilterPointers, &mGateGainPointers, &mIRPointers};
+    DSP_SAMPLE* next = mArena.get();
+    for (size_t b = 0; b < kNumArenaBuffers; b++)
+      for (size_t c = 0; c < kNumChannelsInternal; c++, next += stride)
+        (*buffers[b])[c] = next;
+  };
+  // Fallback that just copies inputs to outputs if there isn't a model.
+  void _FallbackDSP(DSP_SAMPLE** inputs, DSP_SAMPLE** outputs, const size_t numChannels, const size_t numFrames)
+  {
+    for (size_t c = 0; c < numChannels; c++)
+      std::copy(inputs[c], inputs[c] + numFrames, outputs[c]);
+  };
+  void _InitToneStack()
+  {
+    // If you want to customize the tone stack, then put it here!
+    mToneStack = std::make_unique<dsp::tone_stack::BasicNamToneStack>();
+  };
+  double mSampleRate = 48000.0;
+
+  // Storage for the buffers below. See _AllocateArena().
+  static constexpr size_t kArenaAlignment = 64;
+  static constexpr size_t kNumArenaBuffers = 6;
+  struct ArenaDeleter
+  {
+    void operator()(DSP_SAMPLE* p) const { ::operator delete[](p, std::align_val_t(kArenaAlignment)); };
+  };
+  std::unique_ptr<DSP_SAMPLE[], ArenaDeleter> mArena;
+  size_t mMaxBlockSize = 0;
+  // Input to NAM
+  std::array<DSP_SAMPLE*, kNumChannelsInternal> mInputPointers{};
+  // Output from NAM
+  std::array<DSP_SAMPLE*, kNumChannelsInternal> mOutputPointers{};
+  // What's being crossfaded from
+  std::array<DSP_SAMPLE*, kNumChannelsInternal> mCrossfadePointers{};
+  // Output of the post-model filters
+  std::array<DSP_SAMPLE*, kNumChannelsInternal> mFilterPointers{};
+  // Noise gate gain
+  std::array<DSP_SAMPLE*, kNumChannelsInternal> mGateGainPointers{};
+  // Output of an IR that was made for smaller blocks (see ProcessIR())
+  std::array<DSP_SAMPLE*, kNumChannelsInternal> mIRPointers{};
+
+  double mCrossfadeTime = kDefaultCrossfadeTime;
+  Crossfade mModelCrossfade;
+  Crossfade mIRCrossfade;
+
+  // Noise gates
+  std::array<BlockNoiseGate, kNumChannelsInternal> mNoiseGates;
+  // What mNoiseGates were last given
+  struct NoiseGateSettings
+  {
+    double threshold;
+    double openTime;
+    double holdTime;
+    double closeTime;
+    bool operator!=(const NoiseGateSettings& other) const
+    {
+      return threshold != other.threshold || openTime != other.openTime || holdTime != other.holdTime
+             || closeTime != other.closeTime;
+    };
+  };
+  NoiseGateSettings mNoiseGateSettings{};
+  bool mNoiseGateConfigured = false;
+
+  // Tone stack modules
+  std::unique_ptr<dsp::tone_stack::AbstractToneStack> mToneStack;
+
+  // Smoothed parameters
+  SmoothedValue mInputGain{SmoothedValue::Shape::Exponential};
+  SmoothedValue mOutputGain{SmoothedValue::Shape::Exponential};
+  std::array<SmoothedValue, kNumToneStackParams> mToneStackValues;
+  // What the tone stack has been given (NaN: nothing yet)
+  std::array<double, kNumToneStackParams> mAppliedToneStackValues{std::numeric_limits<double>::quiet_NaN(),
+                                                                  std::numeric_limits<double>::quiet_NaN(),
+                                                                  std::numeric_limits<double>::quiet_NaN()};
+
+  // Tone stack biquads, DC blocker, and output gain
+  PostModelFilters mPostModelFilters;
+
+  // Skipping the model (see _ProcessModelOrIdle())
+  // What the state below is about
+  const ResamplingNAM* mIdleModel = nullptr;
+  // How long the input has been silent, up to mModelDrainFrames
+  size_t mSilentFrames = 0;
+  size_t mModelDrainFrames = 0;
+  // The model's output stopped moving after it drained.
+  bool mModelSettled = false;
+  DSP_SAMPLE mHeldModelOutput = 0.0;
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+// Real-time safety checks for the audio callback.
+//
+// Build with NAM_RT_SANITIZER defined and link tools/rt_sanitizer.cpp (the tools' CMake option NAM_RT_SANITIZER does
+// both). Then, while a NAM_REALTIME_SCOPE() is alive on a thread, any allocation, deallocation, mutex lock, or
+// blocking call on that thread is reported with its call stack.
+// Without NAM_RT_SANITIZER, this all compiles to nothing.
+
+#ifdef NAM_RT_SANITIZER
+
+  #include <cstddef>
+
+namespace rt_sanitizer
+{
+// The current thread is real-time while one of these exists.
+class ScopedRealtime
+{
+public:
+  ScopedRealtime();
+  ~ScopedRealtime();
+  ScopedRealtime(const ScopedRealtime&) = delete;
+  ScopedRealtime& operator=(const ScopedRealtime&) = delete;
+};
+
+// Number of violations seen so far (all threads).
+size_t GetNumViolations();
+}; // namespace rt_sanitizer
+
+  #define NAM_REALTIME_SCOPE() rt_sanitizer::ScopedRealtime namRealtimeScope
+
+#else
+
+  #define NAM_REALTIME_SCOPE()
+
+#endif
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cmath> // std::ceil
+#include <functional>
+#include <memory>
+#include <stdexcept>
+
+#include "../AudioDSPTools/dsp/ResamplingContainer/ResamplingContainer.h"
+#include "../NeuralAmpModelerCore/NAM/dsp.h"
+#include "../NeuralAmpModelerCore/NAM/slimmable.h"
+
+#include "ModelSource.h"
+
+// Get the sample rate of a NAM model.
+// Sometimes, the model doesn't know its own sample rate; this wrapper guesses 48k based on the way that most
+// people have used NAM in the past.
+inline double GetNAMSampleRate(const std::unique_ptr<nam::DSP>& model)
+{
+  // Some models are from when we didn't have sample rate in the model.
+  // For those, this wraps with the assumption that they're 48k models, which is probably true.
+  const double assumedSampleRate = 48000.0;
+  const double reportedEncapsulatedSampleRate = model->GetExpectedSampleRate();
+  const double encapsulatedSampleRate =
+    reportedEncapsulatedSampleRate <= 0.0 ? assumedSampleRate : reportedEncapsulatedSampleRate;
+  return encapsulatedSampleRate;
+};
+
+class ResamplingNAM : public nam::DSP
+{
+public:
+  // Resampling wrapper around the NAM models
+  ResamplingNAM(std::unique_ptr<nam::DSP> encapsulated, const double expected_sample_rate)
+  : nam::DSP(encapsulated->NumInputChannels(), encapsulated->NumOutputChannels(), expected_sample_rate)
+  , mEncapsulated(std::move(encapsulated))
+  , mResampler(GetNAMSampleRate(mEncapsulated))
+  {
+    // Assign the encapsulated object's processing function  to this object's member so that the resampler can use it:
+    auto ProcessBlockFunc = [&](NAM_SAMPLE** input, NAM_SAMPLE** output, int numFrames) {
+      mEncapsulated->process(input, output, numFrames);
+    };
+    mBlockProcessFunc = ProcessBlockFunc;
+
+    // Get the other information from the encapsulated NAM so that we can tell the outside world about what we're
+    // holding.
+    if (mEncapsulated->HasLoudness())
+    {
+      SetLoudness(mEncapsulated->GetLoudness());
+    }
+    if (mEncapsulated->HasInputLevel())
+    {
+      SetInputLevel(mEncapsulated->GetInputLevel());
+    }
+    if (mEncapsulated->HasOutputLevel())
+    {
+      SetOutputLevel(mEncapsulated->GetOutputLevel());
+    }
+
+    // NOTE: prewarm samples doesn't mean anything--we can prewarm the encapsulated model as it likes and be good to
+    // go.
+    // _prewarm_samples = 0;
+
+    // And be ready
+    int maxBlockSize = 2048; // Conservative
+    Reset(expected_sample_rate, maxBlockSize);
+  };
+
+  ~ResamplingNAM() = default;
+
+  void prewarm() override { mEncapsulated->prewarm(); };
+
+  void process(NAM_SAMPLE** input, NAM_SAMPLE** output, const int num_frames) override
+  {
+    if (num_frames > mMaxExternalBlockSize)
+      // We can afford to be careful
+      throw std::runtime_error("More frames were provided than the max expected!");
+
+    if (!NeedToResample())
+    {
+      mEncapsulated->process(input, output, num_frames);
+    }
+    else
+    {
+      mResampler.ProcessBlock(input, output, num_frames, mBlockProcessFunc);
+    }
+  };
+
+  int GetLatency() const { return NeedToResample() ? mResampler.GetLatency() : 0; };
+
+  // How long the encapsulated model keeps going after its input stops (seconds). Whoever builds it knows; see
+  // BackgroundLoader::GetModelTailLength().
+  void SetTailLength(const double seconds) { mTailLength = seconds; };
+  double GetTailLength() const { return mTailLength; };
+  // The same, in samples at our sample rate, including the resampler's filters (which ring on both sides).
+  int GetTailSize() const { return (int)std::ceil(mTailLength * GetExpectedSampleRate()) + 2 * GetLatency(); };
+
+  // What the encapsulated model was built from, kept so that it stays shared (see ModelStore.h). May be null.
+  void SetSource(std::shared_ptr<const ModelSource> source) { mSource = std::move(source); };
+  const std::shared_ptr<const ModelSource>& GetSource() const { return mSource; };
+
+  void Reset(const double sampleRate, const int maxBlockSize) override
+  {
+    mExpectedSampleRate = sampleRate;
+    mMaxExternalBlockSize = maxBlockSize;
+    mResampler.Reset(sampleRate, maxBlockSize);
+
+    // Allocations in the encapsulated model (HACK)
+    // Stolen some code from the resampler; it'd be nice to have these exposed as methods? :)
+    const double mUpRatio = sampleRate / GetEncapsulatedSampleRate();
+    const auto maxEncapsulatedBlockSize = static_cast<int>(std::ceil(static_cast<double>(maxBlockSize) / mUpRatio));
+    mEncapsulated->ResetAndPrewarm(sampleRate, maxEncapsulatedBlockSize);
+  };
+
+  // So that we can let the world know if we're resampling (useful for debugging)
+  double GetEncapsulatedSampleRate() const { return GetNAMSampleRate(mEncapsulated); };
+
+  nam::SlimmableModel* GetSlimmableModel() { return dynamic_cast<nam::SlimmableModel*>(mEncapsulated.get()); }
+  const nam::SlimmableModel* GetSlimmableModel() const
+  {
+    return dynamic_cast<const nam::SlimmableModel*>(mEncapsulated.get());
+  }
+
+private:
+  bool NeedToResample() const { return GetExpectedSampleRate() != GetEncapsulatedSampleRate(); };
+  // The encapsulated NAM
+  std::unique_ptr<nam::DSP> mEncapsulated;
+
+  // The resampling wrapper
+  dsp::ResamplingContainer<NAM_SAMPLE, 1, 12> mResampler;
+
+  // Used to check that we don't get too large a block to process.
+  int mMaxExternalBlockSize = 0;
+
+  double mTailLength = 0.0;
+  std::shared_ptr<const ModelSource> mSource;
+
+  // This function is defined to conform to the interface expected by the iPlug2 resampler.
+  std::function<void(NAM_SAMPLE**, NAM_SAMPLE**, int)> mBlockProcessFunc;
+};
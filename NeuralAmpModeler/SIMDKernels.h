@@ -0,0 +1,228 @@
+#pragma once
+
+// Vectorized loops for the ends of the processing chain, for DSP_SAMPLE being float or double.
+// The instruction set is whatever architecture.hpp finds at compile time (AVX, SSE2, or NEON), with a scalar
+// fallback.
+
+#include <algorithm>
+#include <cstddef>
+
+#include "architecture.hpp"
+
+#if defined(ARCH_EXT_AVX) || defined(ARCH_EXT_SSE2)
+  #include <immintrin.h>
+#elif defined(ARCH_EXT_NEON)
+  #include <arm_neon.h>
+#endif
+
+namespace simd_kernels
+{
+namespace detail
+{
+// What the kernels need from a vector type. Lanes is 1 for the fallback.
+template <typename T>
+struct Scalar
+{
+  using Type = T;
+  static constexpr size_t kLanes = 1;
+  static Type Set(const T x) { return x; };
+  static Type Load(const T* p) { return *p; };
+  static void Store(T* p, const Type x) { *p = x; };
+  static Type Add(const Type a, const Type b) { return a + b; };
+  static Type Mul(const Type a, const Type b) { return a * b; };
+  static Type Clamp(const Type x, const Type lo, const Type hi) { return std::min(std::max(x, lo), hi); };
+};
+
+template <typename T>
+struct Vector : Scalar<T>
+{
+};
+
+#if defined(ARCH_EXT_AVX)
+template <>
+struct Vector<float>
+{
+  using Type = __m256;
+  static constexpr size_t kLanes = 8;
+  static Type Set(const float x) { return _mm256_set1_ps(x); };
+  static Type Load(const float* p) { return _mm256_loadu_ps(p); };
+  static void Store(float* p, const Type x) { _mm256_storeu_ps(p, x); };
+  static Type Add(const Type a, const Type b) { return _mm256_add_ps(a, b); };
+  static Type Mul(const Type a, const Type b) { return _mm256_mul_ps(a, b); };
+  static Type Clamp(const Type x, const Type lo, const Type hi) { return _mm256_min_ps(_mm256_max_ps(x, lo), hi); };
+};
+template <>
+struct Vector<double>
+{
+  using Type = __m256d;
+  static constexpr size_t kLanes = 4;
+  static Type Set(const double x) { return _mm256_set1_pd(x); };
+  static Type Load(const double* p) { return _mm256_loadu_pd(p); };
+  static void Store(double* p, const Type x) { _mm256_storeu_pd(p, x); };
+  static Type Add(const Type a, const Type b) { return _mm256_add_pd(a, b); };
+  static Type Mul(const Type a, const Type b) { return _mm256_mul_pd(a, b); };
+  static Type Clamp(const Type x, const Type lo, const Type hi) { return _mm256_min_pd(_mm256_max_pd(x, lo), hi); };
+};
+#elif defined(ARCH_EXT_SSE2)
+template <>
+struct Vector<float>
+{
+  using Type = __m128;
+  static constexpr size_t kLanes = 4;
+  static Type Set(const float x) { return _mm_set1_ps(x); };
+  static Type Load(const float* p) { return _mm_loadu_ps(p); };
+  static void Store(float* p, const Type x) { _mm_storeu_ps(p, x); };
+  static Type Add(const Type a, const Type b) { return _mm_add_ps(a, b); };
+  static Type Mul(const Type a, const Type b) { return _mm_mul_ps(a, b); };
+  static Type Clamp(const Type x, const Type lo, const Type hi) { return _mm_min_ps(_mm_max_ps(x, lo), hi); };
+};
+template <>
+struct Vector<double>
+{
+  using Type = __m128d;
+  static constexpr size_t kLanes = 2;
+  static Type Set(const double x) { return _mm_set1_pd(x); };
+  static Type Load(const double* p) { return _mm_loadu_pd(p); };
+  static void Store(double* p, const Type x) { _mm_storeu_pd(p, x); };
+  static Type Add(const Type a, const Type b) { return _mm_add_pd(a, b); };
+  static Type Mul(const Type a, const Type b) { return _mm_mul_pd(a, b); };
+  static Type Clamp(const Type x, const Type lo, const Type hi) { return _mm_min_pd(_mm_max_pd(x, lo), hi); };
+};
+#elif defined(ARCH_EXT_NEON)
+template <>
+struct Vector<float>
+{
+  using Type = float32x4_t;
+  static constexpr size_t kLanes = 4;
+  static Type Set(const float x) { return vdupq_n_f32(x); };
+  static Type Load(const float* p) { return vld1q_f32(p); };
+  static void Store(float* p, const Type x) { vst1q_f32(p, x); };
+  static Type Add(const Type a, const Type b) { return vaddq_f32(a, b); };
+  static Type Mul(const Type a, const Type b) { return vmulq_f32(a, b); };
+  static Type Clamp(const Type x, const Type lo, const Type hi) { return vminq_f32(vmaxq_f32(x, lo), hi); };
+};
+  #ifdef ARCH_ARM64
+template <>
+struct Vector<double>
+{
+  using Type = float64x2_t;
+  static constexpr size_t kLanes = 2;
+  static Type Set(const double x) { return vdupq_n_f64(x); };
+  static Type Load(const double* p) { return vld1q_f64(p); };
+  static void Store(double* p, const Type x) { vst1q_f64(p, x); };
+  static Type Add(const Type a, const Type b) { return vaddq_f64(a, b); };
+  static Type Mul(const Type a, const Type b) { return vmulq_f64(a, b); };
+  static Type Clamp(const Type x, const Type lo, const Type hi) { return vminq_f64(vmaxq_f64(x, lo), hi); };
+};
+  #endif
+#endif
+
+// Sums the channels and applies the gain, in one pass.
+template <typename V, typename T>
+size_t DownmixWithGain(const T* const* inputs, const size_t numChannels, const size_t start, const size_t numFrames,
+                       const T gain, T* output)
+{
+  const typename V::Type g = V::Set(gain);
+  size_t s = start;
+  for (; s + V::kLanes <= numFrames; s += V::kLanes)
+  {
+    typename V::Type sum = V::Load(inputs[0] + s);
+    for (size_t c = 1; c < numChannels; c++)
+      sum = V::Add(sum, V::Load(inputs[c] + s));
+    V::Store(output + s, V::Mul(sum, g));
+  }
+  return s;
+};
+
+// Same, with the gain multiplied by ratio after every sample. gain is left at what the next sample would get.
+template <typename V, typename T>
+size_t DownmixWithGainRamp(const T* const* inputs, const size_t numChannels, const size_t start,
+                           const size_t numFrames, T& gain, const T ratio, T* output)
+{
+  // Each lane is a sample further along the ramp; every vector moves them all along by kLanes samples.
+  T lanes[V::kLanes];
+  T laneGain = gain;
+  T vectorRatio = (T)1.0;
+  for (size_t i = 0; i < V::kLanes; i++)
+  {
+    lanes[i] = laneGain;
+    laneGain *= ratio;
+    vectorRatio *= ratio;
+  }
+  typename V::Type g = V::Load(lanes);
+  const typename V::Type r = V::Set(vectorRatio);
+  size_t s = start;
+  for (; s + V::kLanes <= numFrames; s += V::kLanes)
+  {
+    typename V::Type sum = V::Load(inputs[0] + s);
+    for (size_t c = 1; c < numChannels; c++)
+      sum = V::Add(sum, V::Load(inputs[c] + s));
+    V::Store(output + s, V::Mul(sum, g));
+    g = V::Mul(g, r);
+    gain *= vectorRatio;
+  }
+  return s;
+};
+
+// Applies the gain (and maybe clamps) once and writes the result to every channel.
+template <typename V, typename T>
+size_t BroadcastWithGain(const T* input, T* const* outputs, const size_t numChannels, const size_t start,
+                         const size_t numFrames, const T gain, const bool clamp)
+{
+  const typename V::Type g = V::Set(gain);
+  const typename V::Type lo = V::Set((T)-1.0);
+  const typename V::Type hi = V::Set((T)1.0);
+  size_t s = start;
+  for (; s + V::kLanes <= numFrames; s += V::kLanes)
+  {
+    typename V::Type x = V::Mul(V::Load(input + s), g);
+    if (clamp)
+      x = V::Clamp(x, lo, hi);
+    for (size_t c = 0; c < numChannels; c++)
+      V::Store(outputs[c] + s, x);
+  }
+  return s;
+};
+}; // namespace detail
+
+// output = gain * (inputs[0] + inputs[1] + ...)
+// Silence if there are no inputs.
+template <typename T>
+void DownmixWithGain(const T* const* inputs, const size_t numChannels, const size_t numFrames, const T gain, T* output)
+{
+  if (numChannels == 0)
+  {
+    std::fill(output, output + numFrames, (T)0.0);
+    return;
+  }
+  // Whole vectors, then whatever is left one at a time
+  const size_t done = detail::DownmixWithGain<detail::Vector<T>>(inputs, numChannels, 0, numFrames, gain, output);
+  detail::DownmixWithGain<detail::Scalar<T>>(inputs, numChannels, done, numFrames, gain, output);
+};
+
+// For frames [startFrame, endFrame): output[s] = gain * ratio^(s - startFrame) * (inputs[0][s] + inputs[1][s] + ...)
+// I.e. an exponential ramp, for smoothing the gain.
+template <typename T>
+void DownmixWithGainRamp(const T* const* inputs, const size_t numChannels, const size_t startFrame,
+                         const size_t endFrame, T gain, const T ratio, T* output)
+{
+  if (numChannels == 0)
+  {
+    std::fill(output + startFrame, output + endFrame, (T)0.0);
+    return;
+  }
+  const size_t done =
+    detail::DownmixWithGainRamp<detail::Vector<T>>(inputs, numChannels, startFrame, endFrame, gain, ratio, output);
+  detail::DownmixWithGainRamp<detail::Scalar<T>>(inputs, numChannels, done, endFrame, gain, ratio, output);
+};
+
+// outputs[c] = gain * input for every c, clamped to [-1, 1] if asked.
+template <typename T>
+void BroadcastWithGain(const T* input, T* const* outputs, const size_t numChannels, const size_t numFrames,
+                       const T gain, const bool clamp)
+{
+  const size_t done =
+    detail::BroadcastWithGain<detail::Vector<T>>(input, outputs, numChannels, 0, numFrames, gain, clamp);
+  detail::BroadcastWithGain<detail::Scalar<T>>(input, outputs, numChannels, done, numFrames, gain, clamp);
+};
+}; // namespace simd_kernels
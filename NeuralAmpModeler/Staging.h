@@ -0,0 +1,126 @@
+#pragma once
+
+// Handing DSP modules to the audio thread and getting rid of the old ones without the audio thread ever allocating
+// or freeing anything.
+//
+// * A loader (UI thread, session recall, ...) puts a fully-built module into a DSPStaging<T>.
+// * The audio thread takes it with one atomic exchange and hands whatever it replaced to the Reclaimer.
+// * The Reclaimer deletes it a little later, on the WorkerPool.
+
+#include <array>
+#include <atomic>
+#include <memory>
+
+#include "WorkerPool.h"
+
+// One slot holding the next module to be used by the audio thread.
+template <typename T>
+class DSPStaging
+{
+public:
+  DSPStaging() = default;
+  DSPStaging(const DSPStaging&) = delete;
+  DSPStaging& operator=(const DSPStaging&) = delete;
+  ~DSPStaging() { delete mStaged.exchange(nullptr); };
+
+  // Not on the audio thread.
+  // Replaces (and deletes) anything that was staged but hasn't been picked up yet.
+  void Stage(std::unique_ptr<T> dsp) { std::unique_ptr<T> previous(mStaged.exchange(dsp.release())); };
+  // Not on the audio thread.
+  // Like Stage(), but if something else got staged in the meantime, then that wins and this is dropped.
+  // Use it to put back something that was taken with Unstage().
+  void Restage(std::unique_ptr<T> dsp)
+  {
+    T* expected = nullptr;
+    if (mStaged.compare_exchange_strong(expected, dsp.get()))
+      dsp.release();
+  };
+  // Not on the audio thread.
+  // Takes back whatever is staged (possibly nothing).
+  std::unique_ptr<T> Unstage() { return std::unique_ptr<T>(mStaged.exchange(nullptr)); };
+
+  // Audio thread.
+  // Takes whatever is staged (possibly nothing).
+  std::unique_ptr<T> Take() { return std::unique_ptr<T>(mStaged.exchange(nullptr)); };
+
+  bool HasStaged() const { return mStaged.load() != nullptr; };
+  // Look without taking. Only safe where nothing can stage at the same time (e.g. under BackgroundLoader's lock).
+  T* Peek() const { return mStaged.load(); };
+
+private:
+  std::atomic<T*> mStaged{nullptr};
+};
+
+// Deletes DSP modules that the audio thread is done with, on the WorkerPool.
+// The audio thread is the only one that retires things (single producer). It doesn't signal anyone; something else
+// (OnIdle) looks in on it with Collect().
+class Reclaimer : public WorkerPool::Client
+{
+public:
+  Reclaimer() = default;
+  ~Reclaimer()
+  {
+    Detach();
+    _Drain();
+  };
+
+  // Audio thread.
+  // Whether there is room to Retire() something. Check this before swapping out a module so that the old one
+  // always has somewhere to go.
+  bool CanRetire() const
+  {
+    return mWrite.load(std::memory_order_relaxed) - mRead.load(std::memory_order_acquire) < kCapacity;
+  };
+
+  // Audio thread.
+  // Takes ownership if there's room (leaving dsp null); otherwise leaves dsp alone and returns false.
+  template <typename T>
+  bool Retire(std::unique_ptr<T>& dsp)
+  {
+    if (dsp == nullptr)
+      return true;
+    if (!CanRetire())
+      return false;
+    const size_t write = mWrite.load(std::memory_order_relaxed);
+    mItems[write % kCapacity] = {dsp.release(), [](void* p) { delete static_cast<T*>(p); }};
+    mWrite.store(write + 1, std::memory_order_release);
+    return true;
+  };
+
+  // Not on the audio thread.
+  // Has whatever was retired deleted. Cheap when there's nothing, so it can be called often.
+  void Collect()
+  {
+    if (mWrite.load(std::memory_order_acquire) != mRead.load(std::memory_order_relaxed))
+      Wake();
+  };
+
+private:
+  struct Item
+  {
+    void* dsp = nullptr;
+    void (*deleter)(void*) = nullptr;
+  };
+
+  void Work() override { _Drain(); };
+
+  void _Drain()
+  {
+    size_t read = mRead.load(std::memory_order_relaxed);
+    const size_t write = mWrite.load(std::memory_order_acquire);
+    for (; read != write; read++)
+    {
+      Item& item = mItems[read % kCapacity];
+      item.deleter(item.dsp);
+      item = Item();
+      mRead.store(read + 1, std::memory_order_release);
+    }
+  };
+
+  static constexpr size_t kCapacity = 16;
+
+  std::array<Item, kCapacity> mItems;
+  // Monotonic counters; the slot is the counter mod kCapacity.
+  std::atomic<size_t> mWrite{0};
+  std::atomic<size_t> mRead{0};
+};
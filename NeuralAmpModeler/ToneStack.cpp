@@ -3,6 +3,22 @@
 DSP_SAMPLE** dsp::tone_stack::BasicNamToneStack::Process(DSP_SAMPLE** inputs, const int numChannels,
                                                          const int numFrames)
 {
+  for (size_t i = 0; i < kNumFilters; i++)
+  {
+    if (!mFilterNeedsUpdate[i])
+      continue;
+    const FilterDesign design = _GetDesign((Param)i, mVals[i]);
+    const recursive_linear_filter::BiquadParams params(
+      GetSampleRate(), design.frequency, design.quality, design.gainDB);
+    switch ((Param)i)
+    {
+      case Param::Bass: mToneBass.SetParams(params); break;
+      case Param::Middle: mToneMid.SetParams(params); break;
+      case Param::Treble: mToneTreble.SetParams(params); break;
+      default: break;
+    }
+    mFilterNeedsUpdate[i] = false;
+  }
   DSP_SAMPLE** bassPointers = mToneBass.Process(inputs, numChannels, numFrames);
   DSP_SAMPLE** midPointers = mToneMid.Process(bassPointers, numChannels, numFrames);
   DSP_SAMPLE** treblePointers = mToneTreble.Process(midPointers, numChannels, numFrames);
@@ -13,49 +29,83 @@ void dsp::tone_stack::BasicNamToneStack::Reset(const double sampleRate, const in
 {
   dsp::tone_stack::AbstractToneStack::Reset(sampleRate, maxBlockSize);
 
+  if (sampleRate != mTableSampleRate)
+  {
+    for (size_t i = 0; i < kNumFilters; i++)
+      mTables[i].Fill([=](const double val) { return _GetCoefficients((Param)i, sampleRate, val); });
+    mTableSampleRate = sampleRate;
+  }
+
   // Refresh the params!
-  SetParam("bass", mBassVal);
-  SetParam("middle", mMiddleVal);
-  SetParam("treble", mTrebleVal);
+  for (size_t i = 0; i < kNumFilters; i++)
+    SetParam((Param)i, mVals[i]);
 }
 
-void dsp::tone_stack::BasicNamToneStack::SetParam(const std::string name, const double val)
+void dsp::tone_stack::BasicNamToneStack::SetParam(const Param param, const double val)
 {
-  if (name == "bass")
-  {
-    // HACK: Store for refresh
-    mBassVal = val;
-    const double sampleRate = GetSampleRate();
-    const double bassGainDB = 4.0 * (val - 5.0); // +/- 20
-    // Hey ChatGPT, the bass frequency is 150 Hz!
-    const double bassFrequency = 150.0;
-    const double bassQuality = 0.707;
-    recursive_linear_filter::BiquadParams bassParams(sampleRate, bassFrequency, bassQuality, bassGainDB);
-    mToneBass.SetParams(bassParams);
-  }
-  else if (name == "middle")
+  const size_t i = (size_t)param;
+  if (i >= kNumFilters)
+    return;
+  // HACK: Store for refresh
+  mVals[i] = val;
+  mFilterNeedsUpdate[i] = true;
+  if (mTableSampleRate > 0.0)
+    mCoefficients[i] = mTables[i].Get(val);
+}
+
+size_t dsp::tone_stack::BasicNamToneStack::GetBiquads(biquad::Coefficients* biquads, const size_t maxBiquads) const
+{
+  if (maxBiquads < kNumFilters)
+    return 0;
+  for (size_t i = 0; i < kNumFilters; i++)
+    biquads[i] = mCoefficients[i];
+  return kNumFilters;
+}
+
+dsp::tone_stack::BasicNamToneStack::FilterDesign dsp::tone_stack::BasicNamToneStack::_GetDesign(const Param param,
+                                                                                                   const double val)
+{
+  switch (param)
   {
-    // HACK: Store for refresh
-    mMiddleVal = val;
-    const double sampleRate = GetSampleRate();
-    const double midGainDB = 3.0 * (val - 5.0); // +/- 15
-    // Hey ChatGPT, the middle frequency is 425 Hz!
-    const double midFrequency = 425.0;
-    // Wider EQ on mid bump up to sound less honky.
-    const double midQuality = midGainDB < 0.0 ? 1.5 : 0.7;
-    recursive_linear_filter::BiquadParams midParams(sampleRate, midFrequency, midQuality, midGainDB);
-    mToneMid.SetParams(midParams);
+    case Param::Bass:
+    {
+      const double bassGainDB = 4.0 * (val - 5.0); // +/- 20
+      // Hey ChatGPT, the bass frequency is 150 Hz!
+      const double bassFrequency = 150.0;
+      const double bassQuality = 0.707;
+      return {bassFrequency, bassQuality, bassGainDB};
+    }
+    case Param::Middle:
+    {
+      const double midGainDB = 3.0 * (val - 5.0); // +/- 15
+      // Hey ChatGPT, the middle frequency is 425 Hz!
+      const double midFrequency = 425.0;
+      // Wider EQ on mid bump up to sound less honky.
+      const double midQuality = midGainDB < 0.0 ? 1.5 : 0.7;
+      return {midFrequency, midQuality, midGainDB};
+    }
+    case Param::Treble:
+    default:
+    {
+      const double trebleGainDB = 2.0 * (val - 5.0); // +/- 10
+      // Hey ChatGPT, the treble frequency is 1800 Hz!
+      const double trebleFrequency = 1800.0;
+      const double trebleQuality = 0.707;
+      return {trebleFrequency, trebleQuality, trebleGainDB};
+    }
   }
-  else if (name == "treble")
+}
+
+dsp::biquad::Coefficients dsp::tone_stack::BasicNamToneStack::_GetCoefficients(const Param param,
+                                                                             const double sampleRate,
+                                                                             const double val)
+{
+  const FilterDesign d = _GetDesign(param, val);
+  switch (param)
   {
-    // HACK: Store for refresh
-    mTrebleVal = val;
-    const double sampleRate = GetSampleRate();
-    const double trebleGainDB = 2.0 * (val - 5.0); // +/- 10
-    // Hey ChatGPT, the treble frequency is 1800 Hz!
-    const double trebleFrequency = 1800.0;
-    const double trebleQuality = 0.707;
-    recursive_linear_filter::BiquadParams trebleParams(sampleRate, trebleFrequency, trebleQuality, trebleGainDB);
-    mToneTreble.SetParams(trebleParams);
+    case Param::Bass: return biquad::Coefficients::LowShelf(sampleRate, d.frequency, d.quality, d.gainDB);
+    case Param::Middle: return biquad::Coefficients::Peaking(sampleRate, d.frequency, d.quality, d.gainDB);
+    case Param::Treble:
+    default: return biquad::Coefficients::HighShelf(sampleRate, d.frequency, d.quality, d.gainDB);
   }
 }
@@ -1,13 +1,25 @@
 #pragma once
 
+#include <algorithm> // std::min, std::max
+#include <array>
 #include <string>
 #include "../AudioDSPTools/dsp/dsp.h"
 #include "../AudioDSPTools/dsp/RecursiveLinearFilter.h"
+#include "Biquad.h"
 
 namespace dsp
 {
 namespace tone_stack
 {
+// The knobs that the plugin has. Tone stacks ignore the ones they don't use.
+enum class Param
+{
+  Bass = 0,
+  Middle,
+  Treble,
+  NumParams
+};
+
 class AbstractToneStack
 {
 public:
@@ -21,9 +33,32 @@ public:
     mSampleRate = sampleRate;
     mMaxBlockSize = maxBlockSize;
   };
-  // Set the various parameters of your tone stack by name.
-  // Call this during OnParamChange()
-  virtual void SetParam(const std::string name, const double val) = 0;
+  // Set the various parameters of your tone stack.
+  // Safe to call from the audio thread: no allocation, strings, or trig.
+  virtual void SetParam(const Param param, const double val) = 0;
+  // By name ("bass", "middle", "treble"), for convenience. Unknown names are ignored.
+  void SetParam(const std::string& name, const double val)
+  {
+    Param param;
+    if (GetParamFromName(name, param))
+      SetParam(param, val);
+  };
+  static bool GetParamFromName(const std::string& name, Param& param)
+  {
+    if (name == "bass")
+      param = Param::Bass;
+    else if (name == "middle")
+      param = Param::Middle;
+    else if (name == "treble")
+      param = Param::Treble;
+    else
+      return false;
+    return true;
+  };
+  // Tone stacks that are a cascade of biquads can hand them over so that the processing chain can run them together
+  // with its other filters (see PostModelFilters.h) instead of calling Process().
+  // Writes up to maxBiquads and returns how many; 0 means "call Process()".
+  virtual size_t GetBiquads(biquad::Coefficients* /*biquads*/, const size_t /*maxBiquads*/) const { return 0; };
 
 protected:
   double GetSampleRate() const { return mSampleRate; };
@@ -31,31 +66,90 @@ protected:
   int mMaxBlockSize = 0;
 };
 
+// A filter's coefficients at every knob position on a grid, so that turning the knob is a lookup and an
+// interpolation instead of a redesign.
+// Biquads are stable in a convex region of (a1, a2), so interpolating between two stable ones stays stable.
+class CoefficientTable
+{
+public:
+  // Knob from 0 to 10 in steps of 0.05
+  static constexpr double kMinValue = 0.0;
+  static constexpr double kMaxValue = 10.0;
+  static constexpr size_t kNumPoints = 201;
+
+  // :param design: (knob value) -> Coefficients
+  template <typename Design>
+  void Fill(Design&& design)
+  {
+    for (size_t i = 0; i < kNumPoints; i++)
+      mTable[i] = design(kMinValue + (double)i * kStep);
+  };
+  biquad::Coefficients Get(const double val) const
+  {
+    const double position = (std::min(std::max(val, kMinValue), kMaxValue) - kMinValue) / kStep;
+    const size_t i = std::min((size_t)position, kNumPoints - 2);
+    const double t = position - (double)i;
+    const biquad::Coefficients& lo = mTable[i];
+    const biquad::Coefficients& hi = mTable[i + 1];
+    biquad::Coefficients c;
+    c.b0 = lo.b0 + t * (hi.b0 - lo.b0);
+    c.b1 = lo.b1 + t * (hi.b1 - lo.b1);
+    c.b2 = lo.b2 + t * (hi.b2 - lo.b2);
+    c.a1 = lo.a1 + t * (hi.a1 - lo.a1);
+    c.a2 = lo.a2 + t * (hi.a2 - lo.a2);
+    return c;
+  };
+
+private:
+  static constexpr double kStep = (kMaxValue - kMinValue) / (double)(kNumPoints - 1);
+  std::array<biquad::Coefficients, kNumPoints> mTable;
+};
+
 class BasicNamToneStack : public AbstractToneStack
 {
 public:
   BasicNamToneStack()
   {
-    SetParam("bass", 5.0);
-    SetParam("middle", 5.0);
-    SetParam("treble", 5.0);
+    SetParam(Param::Bass, 5.0);
+    SetParam(Param::Middle, 5.0);
+    SetParam(Param::Treble, 5.0);
   };
   ~BasicNamToneStack() = default;
 
   DSP_SAMPLE** Process(DSP_SAMPLE** inputs, const int numChannels, const int numFrames) override;
+  // Fills the coefficient tables for the new sample rate.
   void Reset(const double sampleRate, const int maxBlockSize) override;
+  using AbstractToneStack::SetParam;
   // :param val: Assumed to be between 0 and 10, 5 is "noon"
-  void SetParam(const std::string name, const double val) override;
+  void SetParam(const Param param, const double val) override;
+  size_t GetBiquads(biquad::Coefficients* biquads, const size_t maxBiquads) const override;
 
 protected:
+  static constexpr size_t kNumFilters = (size_t)Param::NumParams;
+  // What each knob does
+  struct FilterDesign
+  {
+    double frequency;
+    double quality;
+    double gainDB;
+  };
+  static FilterDesign _GetDesign(const Param param, const double val);
+  static biquad::Coefficients _GetCoefficients(const Param param, const double sampleRate, const double val);
+
+  // For Process(). Their params are only updated there, and only if the knob moved.
   recursive_linear_filter::LowShelf mToneBass;
   recursive_linear_filter::Peaking mToneMid;
   recursive_linear_filter::HighShelf mToneTreble;
+  std::array<bool, kNumFilters> mFilterNeedsUpdate{true, true, true};
+
+  // For GetBiquads()
+  double mTableSampleRate = 0.0;
+  std::array<CoefficientTable, kNumFilters> mTables;
+  // Pass-through until Reset() gives us a sample rate
+  std::array<biquad::Coefficients, kNumFilters> mCoefficients;
 
   // HACK not DRY w knob defs
-  double mBassVal = 5.0;
-  double mMiddleVal = 5.0;
-  double mTrebleVal = 5.0;
+  std::array<double, kNumFilters> mVals{5.0, 5.0, 5.0};
 };
 }; // namespace tone_stack
 }; // namespace dsp
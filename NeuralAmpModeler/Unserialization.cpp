@@ -97,11 +97,85 @@ void _RenameKeys(nlohmann::json& j, std::unordered_map<std::string, std::string>
   }
 }
 
+// v0.7.16
+
+void _UpdateConfigFrom_0_7_16(nlohmann::json& config)
+{
+  // Fill me in once something changes!
+}
+
+int _GetConfigFrom_0_7_16(const iplug::IByteChunk& chunk, int startPos, nlohmann::json& config)
+{
+  std::vector<std::string> paramNames{"Input",
+                                      "Threshold",
+                                      "Bass",
+                                      "Middle",
+                                      "Treble",
+                                      "Output",
+                                      "NoiseGateActive",
+                                      "ToneStack",
+                                      "IRToggle",
+                                      "CalibrateInput",
+                                      "InputCalibrationLevel",
+                                      "OutputMode",
+                                      "Slim",
+                                      "GateAttack",
+                                      "GateHold",
+                                      "GateRelease",
+                                      "IRTrim",
+                                      "IRTrimThreshold",
+                                      "IRMinimumPhase"};
+
+  int pos = _UnserializePathsAndExpectedKeys(chunk, startPos, config, paramNames);
+  _UpdateConfigFrom_0_7_16(config);
+  return pos;
+}
+
+// v0.7.15
+
+void _UpdateConfigFrom_0_7_15(nlohmann::json& config)
+{
+  // IRs used to be loaded as they are.
+  config[kIRTrimParamName] = false;
+  config[kIRTrimThresholdParamName] = dsp::kDefaultIRTrimThreshold;
+  config[kIRMinimumPhaseParamName] = false;
+  _UpdateConfigFrom_0_7_16(config);
+}
+
+int _GetConfigFrom_0_7_15(const iplug::IByteChunk& chunk, int startPos, nlohmann::json& config)
+{
+  std::vector<std::string> paramNames{"Input",
+                                      "Threshold",
+                                      "Bass",
+                                      "Middle",
+                                      "Treble",
+                                      "Output",
+                                      "NoiseGateActive",
+                                      "ToneStack",
+                                      "IRToggle",
+                                      "CalibrateInput",
+                                      "InputCalibrationLevel",
+                                      "OutputMode",
+                                      "Slim",
+                                      "GateAttack",
+                                      "GateHold",
+                                      "GateRelease"};
+
+  int pos = _UnserializePathsAndExpectedKeys(chunk, startPos, config, paramNames);
+  _UpdateConfigFrom_0_7_15(config);
+  return pos;
+}
+
 // v0.7.14
 
 void _UpdateConfigFrom_0_7_14(nlohmann::json& config)
 {
-  // Fill me in once something changes!
+  // The noise gate's timing became parameters. These are the values it always had. It never got as far as holding
+  // (see BlockNoiseGate::kOpenDB), so it sounded like no hold at all.
+  config[kNoiseGateAttackParamName] = kDefaultNoiseGateAttack;
+  config[kNoiseGateHoldParamName] = 0.0;
+  config[kNoiseGateReleaseParamName] = kDefaultNoiseGateRelease;
+  _UpdateConfigFrom_0_7_15(config);
 }
 
 int _GetConfigFrom_0_7_14(const iplug::IByteChunk& chunk, int startPos, nlohmann::json& config)
@@ -277,7 +351,15 @@ int NeuralAmpModeler::_UnserializeStateWithKnownVersion(const iplug::IByteChunk&
   _Version version(versionStr);
   // Act accordingly
   nlohmann::json config;
-  if (version >= _Version(0, 7, 14))
+  if (version >= _Version(0, 7, 16))
+  {
+    pos = _GetConfigFrom_0_7_16(chunk, pos, config);
+  }
+  else if (version >= _Version(0, 7, 15))
+  {
+    pos = _GetConfigFrom_0_7_15(chunk, pos, config);
+  }
+  else if (version >= _Version(0, 7, 14))
   {
     pos = _GetConfigFrom_0_7_14(chunk, pos, config);
   }
@@ -0,0 +1,157 @@
+#pragma once
+
+// Threads shared by every plugin instance in the process, for the work that would otherwise need a thread (or two) per
+// instance: loading (BackgroundLoader) and deleting what the audio thread is done with (Reclaimer).
+//
+// * A client calls Wake() when it has something to do, and one of the threads calls its Work() soon after. A client is
+//   only worked on by one thread at a time, so its work gets done in order.
+// * Threads are started as they're needed, up to one per core, and sleep while there's nothing to do.
+// * Every client holds on to the pool, and the threads stop with the last client, in its destructor. (Not at static
+//   destruction, which for a plugin happens while the host is unloading it.)
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkerPool
+{
+public:
+  class Client
+  {
+  public:
+    Client()
+    : mPool(WorkerPool::_Acquire())
+    {
+    }
+    Client(const Client&) = delete;
+    Client& operator=(const Client&) = delete;
+    virtual ~Client() = default;
+
+  protected:
+    // Not on the audio thread, and not from Work().
+    // Has Work() called (again, if it's being called right now).
+    void Wake() { mPool->_Wake(this); };
+    // Call at the start of the destructor of whatever implements Work(). Waits for Work() to return if it's being
+    // called, and keeps it from being called again.
+    void Detach() { mPool->_Detach(this); };
+    // On one of the pool's threads. Do everything there is to do before returning.
+    virtual void Work() = 0;
+
+  private:
+    friend class WorkerPool;
+
+    std::shared_ptr<WorkerPool> mPool;
+    // Guarded by the pool's mutex
+    bool mQueued = false;
+    bool mWorking = false;
+    bool mWokenWhileWorking = false;
+    bool mDetached = false;
+  };
+
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+  ~WorkerPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mStop = true;
+    }
+    mCondition.notify_all();
+    for (std::thread& thread : mThreads)
+      thread.join();
+  };
+
+private:
+  WorkerPool()
+  : mMaxThreads(std::max(1u, std::thread::hardware_concurrency()))
+  {
+  }
+
+  static std::shared_ptr<WorkerPool> _Acquire()
+  {
+    static std::mutex mutex;
+    static std::weak_ptr<WorkerPool> current;
+    std::lock_guard<std::mutex> lock(mutex);
+    std::shared_ptr<WorkerPool> pool = current.lock();
+    if (pool == nullptr)
+    {
+      pool = std::shared_ptr<WorkerPool>(new WorkerPool());
+      current = pool;
+    }
+    return pool;
+  };
+
+  void _Wake(Client* client)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      if (client->mDetached || client->mQueued)
+        return;
+      if (client->mWorking)
+      {
+        // Whoever is working on it goes around again, so that no two threads work on it at once.
+        client->mWokenWhileWorking = true;
+        return;
+      }
+      client->mQueued = true;
+      mQueue.push_back(client);
+      if (mQueue.size() > mNumIdle && mThreads.size() < mMaxThreads)
+        mThreads.emplace_back([this]() { _Run(); });
+    }
+    mCondition.notify_one();
+  };
+
+  void _Detach(Client* client)
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+    client->mDetached = true;
+    if (client->mQueued)
+    {
+      mQueue.erase(std::find(mQueue.begin(), mQueue.end(), client));
+      client->mQueued = false;
+    }
+    mWorkDone.wait(lock, [client]() { return !client->mWorking; });
+  };
+
+  void _Run()
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true)
+    {
+      mNumIdle++;
+      mCondition.wait(lock, [this]() { return mStop || !mQueue.empty(); });
+      mNumIdle--;
+      if (mStop)
+        return;
+      Client* client = mQueue.front();
+      mQueue.pop_front();
+      client->mQueued = false;
+      client->mWorking = true;
+      do
+      {
+        client->mWokenWhileWorking = false;
+        lock.unlock();
+        client->Work();
+        lock.lock();
+      } while (client->mWokenWhileWorking && !client->mDetached);
+      client->mWorking = false;
+      mWorkDone.notify_all();
+    }
+  };
+
+  const size_t mMaxThreads;
+
+  std::mutex mMutex;
+  // Clients waiting for a thread
+  std::condition_variable mCondition;
+  // Clients that were being worked on, for Detach()
+  std::condition_variable mWorkDone;
+  std::deque<Client*> mQueue;
+  std::vector<std::thread> mThreads;
+  size_t mNumIdle = 0;
+  bool mStop = false;
+};
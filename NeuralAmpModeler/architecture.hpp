@@ -56,6 +56,16 @@
 	#define ARCH_EXT_SSE3
 #endif
 
+/* clang, gcc & msvc (/arch:AVX) */
+#ifdef __AVX__
+	#define ARCH_EXT_AVX
+#endif
+
+/* Arm64 always has it */
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(ARCH_ARM64)
+	#define ARCH_EXT_NEON
+#endif
+
 /* msvc */
 #if defined(ARCH_X86_64)
 	#define ARCH_EXT_SSE
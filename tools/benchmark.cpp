@@ -0,0 +1,480 @@
+// Times each stage of the plugin's processing chain on its own.
+//
+// Usage (from the root of the repo):
+//   benchmark [options] [model ...]
+//
+// Options:
+//   --input <path.wav>   Signal to process (default: REAPER/Guitar DI.wav; looped as needed)
+//   --ir <path.wav>      IR to use (default: a synthetic 8192-tap decaying noise burst)
+//   --seconds <s>        Length of audio to process for each configuration (default: 2)
+//   --json <path>        Write a machine-readable report
+//   --model-cache <MB>   How much the process-wide model cache keeps once nobody uses it (default: 64)
+//
+// If no models are given, the ones that come with the repo are used.
+//
+// After the timings, it loads each model a few times over, the way plugin instances would, and reports how much
+// memory the first one takes and how much each one after that adds (the config is only parsed once; see ModelStore.h).
+// Last, it reports how often a load found the model already parsed, and how much time that saved.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+  #define NOMINMAX
+  #define WIN32_LEAN_AND_MEAN
+  #include <windows.h>
+  #include <psapi.h>
+#elif defined(__APPLE__)
+  #include <mach/mach.h>
+#elif defined(__linux__)
+  #include <unistd.h>
+#endif
+
+#include "../NeuralAmpModelerCore/NAM/activations.h"
+
+#include "common.h"
+
+namespace
+{
+enum EStage
+{
+  kStagePrepareBuffers = 0,
+  kStageInput,
+  kStageNoiseGate,
+  kStageModel,
+  kStagePostModelFilters,
+  kStageIR,
+  kStageOutput,
+  kStageMeters,
+  kNumStages
+};
+
+const char* kStageNames[kNumStages] = {"PrepareBuffers", "Input", "NoiseGate", "Model", "PostModelFilters",
+                                       "IR",             "Output", "Meters"};
+
+// Stand-in for what _UpdateMeters() runs (iPlug2's IPeakAvgSender, which we don't have here): follow the peak and
+// the mean square of every sample, using NAMSender's times.
+class MeterStandIn
+{
+public:
+  void Reset(const double sampleRate)
+  {
+    const double attackTime = 0.001;
+    const double decayTime = 0.3;
+    mAttack = std::exp(-1.0 / (attackTime * sampleRate));
+    mDecay = std::exp(-1.0 / (decayTime * sampleRate));
+    mPeak = 0.0;
+    mMeanSquare = 0.0;
+  };
+  void ProcessBlock(DSP_SAMPLE** inputs, const size_t numFrames)
+  {
+    for (size_t s = 0; s < numFrames; s++)
+    {
+      const double x = std::fabs(inputs[0][s]);
+      mPeak = x > mPeak ? mAttack * mPeak + (1.0 - mAttack) * x : mDecay * mPeak;
+      mMeanSquare = mDecay * mMeanSquare + (1.0 - mDecay) * x * x;
+    }
+  };
+
+private:
+  double mAttack = 0.0;
+  double mDecay = 0.0;
+  double mPeak = 0.0;
+  double mMeanSquare = 0.0;
+};
+
+std::string GetArchitecture(const std::string& modelPath)
+{
+  std::filesystem::path path = std::filesystem::u8path(modelPath);
+  if (std::filesystem::is_directory(path))
+    path /= "config.json";
+  std::ifstream in(path);
+  nlohmann::json j;
+  in >> j;
+  return j["architecture"];
+}
+
+std::unique_ptr<ConvolutionIR> MakeSyntheticIR(const double sampleRate, const int blockSize)
+{
+  dsp::ImpulseResponse::IRData irData;
+  irData.mRawAudioSampleRate = 48000.0;
+  irData.mRawAudio.resize(8192);
+  std::minstd_rand generator(0);
+  std::normal_distribution<float> noise(0.0f, 1.0f);
+  for (size_t i = 0; i < irData.mRawAudio.size(); i++)
+    irData.mRawAudio[i] = noise(generator) * std::exp(-(float)i / 1000.0f);
+  return std::make_unique<ConvolutionIR>(std::make_shared<IRSource>(irData), sampleRate, blockSize);
+}
+
+struct Result
+{
+  std::string model;
+  std::string architecture;
+  double sampleRate = 0.0;
+  int blockSize = 0;
+  size_t numSamples = 0;
+  double stageSeconds[kNumStages] = {};
+  // Process() in one go, to keep the per-stage timing honest.
+  double totalSeconds = 0.0;
+};
+
+// How many times each model is loaded for the memory report
+const int kNumInstances = 8;
+
+struct MemoryResult
+{
+  std::string model;
+  // Bytes
+  size_t weights = 0;
+  size_t firstInstance = 0;
+  size_t eachMoreInstance = 0;
+};
+
+// Bytes. 0 if we can't tell on this platform.
+size_t GetResidentMemory()
+{
+#if defined(_WIN32)
+  PROCESS_MEMORY_COUNTERS counters;
+  if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    return (size_t)counters.WorkingSetSize;
+  return 0;
+#elif defined(__APPLE__)
+  mach_task_basic_info_data_t info;
+  mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+  if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) == KERN_SUCCESS)
+    return (size_t)info.resident_size;
+  return 0;
+#elif defined(__linux__)
+  long pages = 0, residentPages = 0;
+  std::ifstream statm("/proc/self/statm");
+  if (statm >> pages >> residentPages)
+    return (size_t)residentPages * (size_t)sysconf(_SC_PAGESIZE);
+  return 0;
+#else
+  return 0;
+#endif
+}
+
+size_t Growth(const size_t before, const size_t after)
+{
+  return after > before ? after - before : 0;
+}
+
+double NanosecondsPerSample(const double seconds, const size_t numSamples)
+{
+  return 1.0e9 * seconds / (double)numSamples;
+}
+
+double RealTimeFactor(const double seconds, const Result& result)
+{
+  return seconds / ((double)result.numSamples / result.sampleRate);
+}
+
+Result Run(const std::string& modelPath, const std::string& architecture, const std::string& irPath,
+           const std::vector<float>& signal, const double sampleRate, const int blockSize, const double seconds)
+{
+  using Clock = std::chrono::steady_clock;
+
+  Result result;
+  result.model = modelPath;
+  result.architecture = architecture;
+  result.sampleRate = sampleRate;
+  result.blockSize = blockSize;
+
+  nam_tools::PluginParameters params;
+  std::unique_ptr<ResamplingNAM> model = nam_tools::LoadModel(modelPath, sampleRate, blockSize);
+  std::unique_ptr<ConvolutionIR> ir =
+    irPath.empty() ? MakeSyntheticIR(sampleRate, blockSize) : nam_tools::LoadIR(irPath, sampleRate, blockSize);
+
+  ProcessingChain chain;
+  chain.Reset(sampleRate, blockSize);
+  const ProcessingChain::BlockSettings settings = params.GetBlockSettings(model.get());
+  MeterStandIn inputMeter, outputMeter;
+  inputMeter.Reset(sampleRate);
+  outputMeter.Reset(sampleRate);
+
+  const size_t numBlocks = (size_t)std::ceil(seconds * sampleRate / blockSize);
+  result.numSamples = numBlocks * blockSize;
+  std::vector<DSP_SAMPLE> inputBlock(blockSize), outputBlock(blockSize);
+  DSP_SAMPLE* inputPointers[1] = {inputBlock.data()};
+  DSP_SAMPLE* outputPointers[1] = {outputBlock.data()};
+  size_t signalPosition = 0;
+  auto fillInput = [&]() {
+    for (int s = 0; s < blockSize; s++)
+    {
+      inputBlock[s] = signal[signalPosition];
+      signalPosition = (signalPosition + 1) % signal.size();
+    }
+  };
+
+  std::fenv_t fe_state;
+  std::feholdexcept(&fe_state);
+  disable_denormals();
+
+  Clock::duration stageTimes[kNumStages] = {};
+  for (size_t b = 0; b < numBlocks; b++)
+  {
+    const size_t numFrames = (size_t)blockSize;
+    fillInput();
+    auto t = Clock::now();
+    auto lap = [&](const EStage stage) {
+      const auto now = Clock::now();
+      stageTimes[stage] += now - t;
+      t = now;
+    };
+
+    chain.PrepareBuffers(kNumChannelsInternal, numFrames);
+    lap(kStagePrepareBuffers);
+    chain.ProcessInput(inputPointers, numFrames, 1, kNumChannelsInternal, settings.inputGain);
+    lap(kStageInput);
+    DSP_SAMPLE** gateGains =
+      chain.ProcessNoiseGate(chain.GetInputPointers(), kNumChannelsInternal, numFrames, settings);
+    lap(kStageNoiseGate);
+    chain.ProcessModel(model.get(), chain.GetInputPointers(), kNumChannelsInternal, numFrames);
+    lap(kStageModel);
+    DSP_SAMPLE** filterOutput =
+      chain.ProcessPostModelFilters(chain.GetOutputPointers(), kNumChannelsInternal, numFrames, settings, gateGains);
+    lap(kStagePostModelFilters);
+    DSP_SAMPLE** irOutput = chain.ProcessIR(ir.get(), filterOutput, kNumChannelsInternal, numFrames);
+    lap(kStageIR);
+    chain.ProcessOutput(irOutput, outputPointers, numFrames, kNumChannelsInternal, 1, 1.0);
+    lap(kStageOutput);
+    inputMeter.ProcessBlock(chain.GetInputPointers(), numFrames);
+    outputMeter.ProcessBlock(outputPointers, numFrames);
+    lap(kStageMeters);
+  }
+  std::feupdateenv(&fe_state);
+
+  // And the whole thing through Process()
+  Clock::duration totalTime(0);
+  for (size_t b = 0; b < numBlocks; b++)
+  {
+    fillInput();
+    const auto t0 = Clock::now();
+    chain.Process(inputPointers, outputPointers, 1, 1, blockSize, model.get(), ir.get(), settings);
+    inputMeter.ProcessBlock(chain.GetInputPointers(), blockSize);
+    outputMeter.ProcessBlock(outputPointers, blockSize);
+    totalTime += Clock::now() - t0;
+  }
+
+  for (int i = 0; i < kNumStages; i++)
+    result.stageSeconds[i] = std::chrono::duration<double>(stageTimes[i]).count();
+  result.totalSeconds = std::chrono::duration<double>(totalTime).count();
+  return result;
+}
+
+// Like a session with kNumInstances plugin instances on the same model
+MemoryResult MeasureMemory(const std::string& modelPath)
+{
+  const double sampleRate = 48000.0;
+  const int blockSize = 64;
+  MemoryResult result;
+  result.model = modelPath;
+  std::vector<std::unique_ptr<ResamplingNAM>> instances;
+  // Otherwise the first instance finds it in the cache from the timings.
+  ModelStore::Get().ClearCache();
+  const size_t start = GetResidentMemory();
+  instances.push_back(nam_tools::LoadModel(modelPath, sampleRate, blockSize));
+  const size_t first = GetResidentMemory();
+  for (int i = 1; i < kNumInstances; i++)
+    instances.push_back(nam_tools::LoadModel(modelPath, sampleRate, blockSize));
+  const size_t all = GetResidentMemory();
+  if (const auto& source = instances.front()->GetSource())
+    result.weights = source->GetWeightsSize();
+  result.firstInstance = Growth(start, first);
+  result.eachMoreInstance = Growth(first, all) / (kNumInstances - 1);
+  return result;
+}
+
+void PrintMemoryHeader()
+{
+  std::printf("\n%-40s %14s %14s %14s\n", "model", "weights (KB)", "first (KB)", "each more (KB)");
+}
+
+void PrintMemoryResult(const MemoryResult& r)
+{
+  std::printf("%-40.40s %14.1f %14.1f %14.1f\n", r.model.c_str(), r.weights / 1024.0, r.firstInstance / 1024.0,
+              r.eachMoreInstance / 1024.0);
+  std::fflush(stdout);
+}
+
+nlohmann::json ToJson(const MemoryResult& r)
+{
+  nlohmann::json j;
+  j["model"] = r.model;
+  j["weights_bytes"] = r.weights;
+  j["first_instance_bytes"] = r.firstInstance;
+  j["each_more_instance_bytes"] = r.eachMoreInstance;
+  return j;
+}
+
+void PrintModelCache(const ModelStore::Stats& stats)
+{
+  const size_t numLoads = stats.hits + stats.misses;
+  std::printf("\nModel cache: %zu of %zu loads hit (%.1f%%), %.1f ms saved, %.1f of %.1f MB kept\n", stats.hits,
+              numLoads, numLoads > 0 ? 100.0 * stats.hits / numLoads : 0.0, 1000.0 * stats.secondsSaved,
+              stats.cacheSize / 1048576.0, stats.cacheLimit / 1048576.0);
+}
+
+nlohmann::json ToJson(const ModelStore::Stats& stats)
+{
+  nlohmann::json j;
+  j["hits"] = stats.hits;
+  j["misses"] = stats.misses;
+  j["seconds_saved"] = stats.secondsSaved;
+  j["size_bytes"] = stats.cacheSize;
+  j["limit_bytes"] = stats.cacheLimit;
+  return j;
+}
+
+void PrintHeader()
+{
+  std::printf("%-40s %-9s %6s %5s", "model", "arch", "rate", "block");
+  for (int i = 0; i < kNumStages; i++)
+    std::printf(" %10.10s", kStageNames[i]);
+  std::printf(" %10s %8s\n", "total", "RTF");
+}
+
+void PrintResult(const Result& r)
+{
+  std::printf("%-40.40s %-9.9s %6.0f %5d", r.model.c_str(), r.architecture.c_str(), r.sampleRate, r.blockSize);
+  for (int i = 0; i < kNumStages; i++)
+    std::printf(" %10.2f", NanosecondsPerSample(r.stageSeconds[i], r.numSamples));
+  std::printf(" %10.2f %8.4f\n", NanosecondsPerSample(r.totalSeconds, r.numSamples), RealTimeFactor(r.totalSeconds, r));
+  std::fflush(stdout);
+}
+
+nlohmann::json ToJson(const Result& r)
+{
+  nlohmann::json j;
+  j["model"] = r.model;
+  j["architecture"] = r.architecture;
+  j["sample_rate"] = r.sampleRate;
+  j["block_size"] = r.blockSize;
+  j["num_samples"] = r.numSamples;
+  nlohmann::json stages = nlohmann::json::object();
+  for (int i = 0; i < kNumStages; i++)
+  {
+    stages[kStageNames[i]] = {{"ns_per_sample", NanosecondsPerSample(r.stageSeconds[i], r.numSamples)},
+                              {"real_time_factor", RealTimeFactor(r.stageSeconds[i], r)}};
+  }
+  j["stages"] = stages;
+  j["total"] = {{"ns_per_sample", NanosecondsPerSample(r.totalSeconds, r.numSamples)},
+                {"real_time_factor", RealTimeFactor(r.totalSeconds, r)}};
+  return j;
+}
+}; // namespace
+
+int main(int argc, char* argv[])
+{
+  std::string inputPath = "REAPER/Guitar DI.wav";
+  std::string irPath;
+  std::string jsonPath;
+  double seconds = 2.0;
+  std::vector<std::string> models;
+
+  try
+  {
+    for (int i = 1; i < argc; i++)
+    {
+      const std::string arg(argv[i]);
+      auto next = [&]() -> std::string {
+        if (i + 1 >= argc)
+          throw std::invalid_argument("Missing value for " + arg);
+        return std::string(argv[++i]);
+      };
+      if (arg == "--input")
+        inputPath = next();
+      else if (arg == "--ir")
+        irPath = next();
+      else if (arg == "--seconds")
+        seconds = std::stod(next());
+      else if (arg == "--json")
+        jsonPath = next();
+      else if (arg == "--model-cache")
+        ModelStore::Get().SetCacheLimit((size_t)(std::stod(next()) * 1048576.0));
+      else if (arg.rfind("--", 0) == 0)
+        throw std::invalid_argument("Unknown option " + arg);
+      else
+        models.push_back(arg);
+    }
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << e.what() << std::endl;
+    std::cerr << "See the top of tools/benchmark.cpp for usage." << std::endl;
+    return 1;
+  }
+  if (models.empty())
+    models = {"REAPER/model.nam", "Models/deluxe_reverb_vibrato", "Models/2022-11-14-01_rhythm",
+              "Models/dingwall_bass"};
+
+  // Same as the plugin's constructor
+  nam::activations::Activation::enable_fast_tanh();
+
+  const std::vector<double> sampleRates{44100.0, 48000.0, 96000.0};
+  const std::vector<int> blockSizes{16, 32, 64, 128, 256, 512, 1024, 2048, 4096};
+
+  nlohmann::json report;
+  report["seconds_per_configuration"] = seconds;
+  report["input"] = inputPath;
+  report["ir"] = irPath.empty() ? "synthetic" : irPath;
+  report["results"] = nlohmann::json::array();
+  report["memory"] = {{"instances", kNumInstances}, {"results", nlohmann::json::array()}};
+
+  try
+  {
+    double inputSampleRate = 0.0;
+    const std::vector<float> signal = nam_tools::ReadWav(inputPath, inputSampleRate);
+    if (signal.empty())
+      throw std::runtime_error("Input " + inputPath + " is empty");
+
+    PrintHeader();
+    for (const auto& modelPath : models)
+    {
+      const std::string architecture = GetArchitecture(modelPath);
+      for (const double sampleRate : sampleRates)
+      {
+        for (const int blockSize : blockSizes)
+        {
+          const Result result = Run(modelPath, architecture, irPath, signal, sampleRate, blockSize, seconds);
+          PrintResult(result);
+          report["results"].push_back(ToJson(result));
+        }
+      }
+    }
+
+    if (GetResidentMemory() > 0)
+    {
+      PrintMemoryHeader();
+      for (const auto& modelPath : models)
+      {
+        const MemoryResult result = MeasureMemory(modelPath);
+        PrintMemoryResult(result);
+        report["memory"]["results"].push_back(ToJson(result));
+      }
+    }
+
+    const ModelStore::Stats stats = ModelStore::Get().GetStats();
+    PrintModelCache(stats);
+    report["model_cache"] = ToJson(stats);
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+
+  if (!jsonPath.empty())
+  {
+    std::ofstream out(jsonPath);
+    out << report.dump(2) << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+// Things that the offline tools share: loading models and IRs the same way that the plugin does, the plugin's
+// parameters, and (simple) WAV I/O.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../AudioDSPTools/dsp/ImpulseResponse.h"
+#include "../AudioDSPTools/dsp/wav.h"
+#include "../NeuralAmpModeler/ConvolutionIR.h"
+#include "../NeuralAmpModeler/IRProcessing.h"
+#include "../NeuralAmpModeler/Loader.h"
+#include "../NeuralAmpModeler/ProcessingChain.h"
+#include "../NeuralAmpModeler/ResamplingNAM.h"
+
+namespace nam_tools
+{
+inline double DBToAmp(const double db)
+{
+  return std::pow(10.0, db / 20.0);
+}
+
+// The plugin's parameters, with the same defaults (see the NeuralAmpModeler constructor).
+struct PluginParameters
+{
+  double inputLevel = 0.0;
+  double noiseGateThreshold = -80.0;
+  // Milliseconds
+  double noiseGateAttack = 1000.0 * kDefaultNoiseGateOpenTime;
+  double noiseGateHold = 1000.0 * kDefaultNoiseGateHoldTime;
+  double noiseGateRelease = 1000.0 * kDefaultNoiseGateCloseTime;
+  double bass = 5.0;
+  double middle = 5.0;
+  double treble = 5.0;
+  double outputLevel = 0.0;
+  bool noiseGateActive = true;
+  bool eqActive = true;
+  bool irToggle = true;
+  bool calibrateInput = false;
+  double inputCalibrationLevel = 12.0;
+  // 0: Raw, 1: Normalized, 2: Calibrated
+  int outputMode = 1;
+  double slim = 0.0;
+  bool irTrim = false;
+  double irTrimThreshold = dsp::kDefaultIRTrimThreshold;
+  bool irMinimumPhase = false;
+
+  // What NeuralAmpModeler::ProcessBlock() would do with these
+  ProcessingChain::BlockSettings GetBlockSettings(ResamplingNAM* model) const
+  {
+    ProcessingChain::BlockSettings settings;
+    settings.inputGain =
+      DBToAmp(ProcessingChain::GetInputGainDB(model, inputLevel, calibrateInput, inputCalibrationLevel));
+    settings.outputGain =
+      DBToAmp(ProcessingChain::GetOutputGainDB(model, outputLevel, outputMode, inputCalibrationLevel));
+    settings.noiseGateActive = noiseGateActive;
+    settings.noiseGateThreshold = noiseGateThreshold;
+    settings.noiseGateOpenTime = 0.001 * noiseGateAttack;
+    settings.noiseGateHoldTime = 0.001 * noiseGateHold;
+    settings.noiseGateCloseTime = 0.001 * noiseGateRelease;
+    settings.toneStackActive = eqActive;
+    settings.toneStackValues[(size_t)dsp::tone_stack::Param::Bass] = bass;
+    settings.toneStackValues[(size_t)dsp::tone_stack::Param::Middle] = middle;
+    settings.toneStackValues[(size_t)dsp::tone_stack::Param::Treble] = treble;
+    return settings;
+  };
+
+  dsp::IRProcessing GetIRProcessing() const
+  {
+    dsp::IRProcessing processing;
+    processing.trim = irTrim;
+    processing.trimThreshold = irTrimThreshold;
+    processing.minimumPhase = irMinimumPhase;
+    return processing;
+  };
+};
+
+// Same as the plugin's background loader, but right here and now.
+// Works for .nam files and for config.json + weights.npy directories.
+inline std::unique_ptr<ResamplingNAM> LoadModel(const std::string& modelPath, const double sampleRate,
+                                                const int maxBlockSize, const double slim = 0.0)
+{
+  return BackgroundLoader::BuildModel(modelPath, sampleRate, maxBlockSize, slim);
+}
+
+inline std::unique_ptr<ConvolutionIR> LoadIR(const std::string& irPath, const double sampleRate, const int maxBlockSize,
+                                             const dsp::IRProcessing& processing = {})
+{
+  dsp::wav::LoadReturnCode wavState = dsp::wav::LoadReturnCode::ERROR_OTHER;
+  std::unique_ptr<ConvolutionIR> ir = BackgroundLoader::BuildIR(irPath, sampleRate, maxBlockSize, processing, wavState);
+  if (wavState != dsp::wav::LoadReturnCode::SUCCESS)
+  {
+    throw std::runtime_error("Failed to load IR " + irPath + ": " + dsp::wav::GetMsgForLoadReturnCode(wavState));
+  }
+  return ir;
+}
+
+// Mono, like the plugin's insides.
+inline std::vector<float> ReadWav(const std::string& path, double& sampleRate)
+{
+  std::vector<float> audio;
+  const dsp::wav::LoadReturnCode wavState = dsp::wav::Load(path.c_str(), audio, sampleRate);
+  if (wavState != dsp::wav::LoadReturnCode::SUCCESS)
+  {
+    throw std::runtime_error("Failed to read " + path + ": " + dsp::wav::GetMsgForLoadReturnCode(wavState));
+  }
+  return audio;
+}
+
+// Writes 32-bit float mono
+inline void WriteWav(const std::string& path, const std::vector<float>& audio, const double sampleRate)
+{
+  std::ofstream out(path, std::ios::binary);
+  if (!out.is_open())
+    throw std::runtime_error("Failed to open " + path + " for writing");
+
+  auto put32 = [&](const uint32_t v) {
+    const char bytes[4] = {(char)(v & 0xff), (char)((v >> 8) & 0xff), (char)((v >> 16) & 0xff), (char)(v >> 24)};
+    out.write(bytes, 4);
+  };
+  auto put16 = [&](const uint16_t v) {
+    const char bytes[2] = {(char)(v & 0xff), (char)(v >> 8)};
+    out.write(bytes, 2);
+  };
+
+  const uint16_t numChannels = 1;
+  const uint16_t bitsPerSample = 32;
+  const uint16_t formatIEEEFloat = 3;
+  const uint32_t rate = (uint32_t)sampleRate;
+  const uint32_t dataSize = (uint32_t)(audio.size() * sizeof(float));
+
+  out.write("RIFF", 4);
+  put32(36 + dataSize);
+  out.write("WAVE", 4);
+  out.write("fmt ", 4);
+  put32(16);
+  put16(formatIEEEFloat);
+  put16(numChannels);
+  put32(rate);
+  put32(rate * numChannels * bitsPerSample / 8);
+  put16(numChannels * bitsPerSample / 8);
+  put16(bitsPerSample);
+  out.write("data", 4);
+  put32(dataSize);
+  // Little-endian hosts only, which is everything we build for.
+  out.write(reinterpret_cast<const char*>(audio.data()), dataSize);
+}
+}; // namespace nam_tools
@@ -0,0 +1,74 @@
+// Converts a model to the binary format (.namb; see NeuralAmpModeler/BinaryModel.h), which loads faster.
+//
+// Usage:
+//   convert_model <model> <out.namb>
+//
+// <model> is a .nam file or a config.json + weights.npy directory (like the ones in Models/). The model is built
+// first, so what can't be loaded isn't converted, and the output is read back and checked against it.
+
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include "common.h"
+
+namespace
+{
+void PrintUsage(const char* name)
+{
+  std::cerr << "Usage: " << name << " <model> <out.namb>" << std::endl;
+}
+}; // namespace
+
+int main(int argc, char* argv[])
+{
+  if (argc != 3)
+  {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+  const auto inputPath = std::filesystem::u8path(argv[1]);
+  const auto outputPath = std::filesystem::u8path(argv[2]);
+  if (!binary_model::IsBinaryModel(outputPath))
+  {
+    std::cerr << "The output should end in " << binary_model::kExtension << ", or the plugin won't know what it is."
+              << std::endl;
+    return 1;
+  }
+
+  try
+  {
+    nam::dspData data;
+    ModelSource::Read(inputPath, data);
+    {
+      // get_dsp() doesn't promise to leave what it's given alone.
+      nam::dspData copy = data;
+      nam::get_dsp(copy);
+    }
+    binary_model::Write(outputPath, data);
+
+    nam::dspData check;
+    binary_model::Read(outputPath, check);
+    if (check.weights != data.weights || check.config != data.config || check.architecture != data.architecture)
+    {
+      throw std::runtime_error("What was written doesn't read back the same");
+    }
+
+    std::error_code error;
+    const auto inputSize = std::filesystem::is_directory(inputPath)
+                             ? std::filesystem::file_size(inputPath / "config.json", error)
+                                 + std::filesystem::file_size(inputPath / "weights.npy", error)
+                             : std::filesystem::file_size(inputPath, error);
+    std::cout << data.architecture << ", " << data.weights.size() << " weights" << std::endl;
+    std::cout << inputSize / 1024 << " KB -> " << std::filesystem::file_size(outputPath) / 1024 << " KB"
+              << std::endl;
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
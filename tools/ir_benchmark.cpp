@@ -0,0 +1,232 @@
+// Compares the IR's partitioned FFT convolution (NeuralAmpModeler/PartitionedConvolution.h) with AudioDSPTools'
+// time-domain one.
+//
+// Usage (from the root of the repo):
+//   ir_benchmark [options]
+//
+// Options:
+//   --seconds <s>   Length of audio to process for each configuration (default: 2)
+//   --json <path>   Write a machine-readable report
+//
+// The IRs are synthetic (decaying noise) at 48 kHz. AudioDSPTools cuts IRs off (at 8192 samples), so for longer
+// ones the time-domain and partitioned columns both convolve with what's left, and "full" is the partitioned
+// convolution with every tap.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "common.h"
+
+namespace
+{
+const double kSampleRate = 48000.0;
+
+struct Result
+{
+  size_t numTaps = 0;
+  // What AudioDSPTools kept
+  size_t numTapsUsed = 0;
+  int blockSize = 0;
+  size_t numSamples = 0;
+  double timeDomainSeconds = 0.0;
+  double partitionedSeconds = 0.0;
+  double fullSeconds = 0.0;
+  // Between the time-domain and partitioned outputs
+  double maxError = 0.0;
+  dsp::PartitionedConvolution::Layout layout;
+};
+
+double NanosecondsPerSample(const double seconds, const size_t numSamples)
+{
+  return 1.0e9 * seconds / (double)numSamples;
+}
+
+dsp::ImpulseResponse::IRData MakeIRData(const size_t numTaps)
+{
+  dsp::ImpulseResponse::IRData irData;
+  irData.mRawAudioSampleRate = kSampleRate;
+  irData.mRawAudio.resize(numTaps);
+  std::minstd_rand generator(0);
+  std::normal_distribution<float> noise(0.0f, 1.0f);
+  // Down by 60 dB at the end
+  const float decay = std::log(1000.0f) / (float)numTaps;
+  for (size_t i = 0; i < numTaps; i++)
+    irData.mRawAudio[i] = noise(generator) * std::exp(-decay * (float)i);
+  return irData;
+}
+
+// Runs the signal through in blocks, timing only the processing.
+template <typename ProcessBlock>
+double Time(const std::vector<DSP_SAMPLE>& signal, std::vector<DSP_SAMPLE>& output, const int blockSize,
+            ProcessBlock processBlock)
+{
+  using Clock = std::chrono::steady_clock;
+  Clock::duration time(0);
+  std::vector<DSP_SAMPLE> block(blockSize);
+  for (size_t offset = 0; offset + blockSize <= signal.size(); offset += blockSize)
+  {
+    std::copy(signal.begin() + offset, signal.begin() + offset + blockSize, block.begin());
+    const auto t0 = Clock::now();
+    const DSP_SAMPLE* result = processBlock(block.data(), (size_t)blockSize);
+    time += Clock::now() - t0;
+    std::copy(result, result + blockSize, output.begin() + offset);
+  }
+  return std::chrono::duration<double>(time).count();
+}
+
+Result Run(const size_t numTaps, const int blockSize, const double seconds)
+{
+  Result result;
+  result.numTaps = numTaps;
+  result.blockSize = blockSize;
+  const size_t numBlocks = (size_t)std::ceil(seconds * kSampleRate / blockSize);
+  result.numSamples = numBlocks * blockSize;
+
+  std::vector<DSP_SAMPLE> signal(result.numSamples);
+  std::minstd_rand generator(1);
+  std::uniform_real_distribution<double> uniform(-0.5, 0.5);
+  for (auto& x : signal)
+    x = (DSP_SAMPLE)uniform(generator);
+
+  const dsp::ImpulseResponse::IRData irData = MakeIRData(numTaps);
+  dsp::ImpulseResponse timeDomain(irData, kSampleRate);
+  ConvolutionIR partitioned(std::make_shared<IRSource>(irData), kSampleRate, blockSize);
+  result.numTapsUsed = partitioned.GetLength();
+  // With the same level as AudioDSPTools applies, but nothing cut off
+  std::vector<float> fullTaps(irData.mRawAudio);
+  if (!partitioned.GetTaps().empty())
+  {
+    const float gain = partitioned.GetTaps()[0] / irData.mRawAudio[0];
+    for (auto& tap : fullTaps)
+      tap *= gain;
+  }
+  dsp::PartitionedConvolution full(fullTaps.data(), fullTaps.size(), (size_t)blockSize);
+  result.layout = full.GetLayout();
+
+  std::fenv_t fe_state;
+  std::feholdexcept(&fe_state);
+  disable_denormals();
+
+  std::vector<DSP_SAMPLE> timeDomainOutput(signal.size()), partitionedOutput(signal.size()),
+    fullOutput(signal.size());
+  result.timeDomainSeconds = Time(signal, timeDomainOutput, blockSize, [&](DSP_SAMPLE* block, const size_t n) {
+    return timeDomain.Process(&block, 1, n)[0];
+  });
+  result.partitionedSeconds = Time(signal, partitionedOutput, blockSize, [&](DSP_SAMPLE* block, const size_t n) {
+    return partitioned.Process(&block, 1, n)[0];
+  });
+  result.fullSeconds = Time(signal, fullOutput, blockSize, [&](DSP_SAMPLE* block, const size_t n) {
+    full.Process(block, block, n);
+    return block;
+  });
+  std::feupdateenv(&fe_state);
+
+  for (size_t i = 0; i < signal.size(); i++)
+    result.maxError = std::max(result.maxError, (double)std::fabs(timeDomainOutput[i] - partitionedOutput[i]));
+  return result;
+}
+
+void PrintHeader()
+{
+  std::printf("%7s %7s %5s %12s %12s %12s %8s %10s  %s\n", "taps", "used", "block", "time-domain", "partitioned",
+              "full", "speedup", "max error", "layout (head/min/max)");
+}
+
+void PrintResult(const Result& r)
+{
+  const double timeDomain = NanosecondsPerSample(r.timeDomainSeconds, r.numSamples);
+  const double partitioned = NanosecondsPerSample(r.partitionedSeconds, r.numSamples);
+  std::printf("%7zu %7zu %5d %12.2f %12.2f %12.2f %8.2f %10.3g  %zu/%zu/%zu\n", r.numTaps, r.numTapsUsed, r.blockSize,
+              timeDomain, partitioned, NanosecondsPerSample(r.fullSeconds, r.numSamples), timeDomain / partitioned,
+              r.maxError, r.layout.headLength, r.layout.minPartitionSize, r.layout.maxPartitionSize);
+  std::fflush(stdout);
+}
+
+nlohmann::json ToJson(const Result& r)
+{
+  nlohmann::json j;
+  j["taps"] = r.numTaps;
+  j["taps_used"] = r.numTapsUsed;
+  j["block_size"] = r.blockSize;
+  j["num_samples"] = r.numSamples;
+  j["time_domain_ns_per_sample"] = NanosecondsPerSample(r.timeDomainSeconds, r.numSamples);
+  j["partitioned_ns_per_sample"] = NanosecondsPerSample(r.partitionedSeconds, r.numSamples);
+  j["full_ns_per_sample"] = NanosecondsPerSample(r.fullSeconds, r.numSamples);
+  j["max_error"] = r.maxError;
+  j["layout"] = {{"head_length", r.layout.headLength},
+                 {"min_partition_size", r.layout.minPartitionSize},
+                 {"max_partition_size", r.layout.maxPartitionSize}};
+  return j;
+}
+}; // namespace
+
+int main(int argc, char* argv[])
+{
+  std::string jsonPath;
+  double seconds = 2.0;
+
+  try
+  {
+    for (int i = 1; i < argc; i++)
+    {
+      const std::string arg(argv[i]);
+      auto next = [&]() -> std::string {
+        if (i + 1 >= argc)
+          throw std::invalid_argument("Missing value for " + arg);
+        return std::string(argv[++i]);
+      };
+      if (arg == "--seconds")
+        seconds = std::stod(next());
+      else if (arg == "--json")
+        jsonPath = next();
+      else
+        throw std::invalid_argument("Unknown option " + arg);
+    }
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << e.what() << std::endl;
+    std::cerr << "See the top of tools/ir_benchmark.cpp for usage." << std::endl;
+    return 1;
+  }
+
+  const std::vector<size_t> tapCounts{512, 2048, 8192, 48000};
+  const std::vector<int> blockSizes{16, 32, 64, 128, 256, 512, 1024, 2048, 4096};
+
+  nlohmann::json report;
+  report["seconds_per_configuration"] = seconds;
+  report["sample_rate"] = kSampleRate;
+  report["results"] = nlohmann::json::array();
+
+  try
+  {
+    PrintHeader();
+    for (const size_t numTaps : tapCounts)
+    {
+      for (const int blockSize : blockSizes)
+      {
+        const Result result = Run(numTaps, blockSize, seconds);
+        PrintResult(result);
+        report["results"].push_back(ToJson(result));
+      }
+    }
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+
+  if (!jsonPath.empty())
+  {
+    std::ofstream out(jsonPath);
+    out << report.dump(2) << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,224 @@
+// Times loading models as they come (.nam files, config.json + weights.npy directories) against loading them from
+// the binary format (see NeuralAmpModeler/BinaryModel.h), and against NeuralAmpModelerCore's own reader
+// (nam::get_dsp(), which the plugin used before NeuralAmpModeler/NamFile.h and NpyFile.h).
+//
+// Usage (from the root of the repo):
+//   load_benchmark [options] [model ...]
+//
+// Options:
+//   --repeats <n>   How many times to load each one (default: 20)
+//   --json <path>   Write a machine-readable report
+//
+// If no models are given, the ones that come with the repo are used. Each is converted to a temporary .namb first.
+// "speedup" is the time to load the model as it comes over the time to load the .namb.
+// Loading is reading and parsing (ModelSource::Read(), bypassing the ModelStore so that nothing is cached); building
+// (nam::get_dsp() from what was read) is timed apart.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../NeuralAmpModelerCore/NAM/activations.h"
+
+#include "common.h"
+
+namespace
+{
+struct Timing
+{
+  // Medians, seconds
+  double load = 0.0;
+  double build = 0.0;
+};
+
+struct Result
+{
+  std::string model;
+  size_t numWeights = 0;
+  // Bytes
+  uintmax_t size = 0;
+  uintmax_t binarySize = 0;
+  Timing original;
+  Timing binary;
+  // nam::get_dsp(); loading and building together. 0 if it can't read the model.
+  double core = 0.0;
+};
+
+double Median(std::vector<double> x)
+{
+  std::sort(x.begin(), x.end());
+  return x.empty() ? 0.0 : x[x.size() / 2];
+}
+
+uintmax_t GetSize(const std::filesystem::path& path)
+{
+  if (!std::filesystem::is_directory(path))
+    return std::filesystem::file_size(path);
+  uintmax_t size = 0;
+  for (const auto& entry : std::filesystem::directory_iterator(path))
+    if (entry.is_regular_file())
+      size += entry.file_size();
+  return size;
+}
+
+Timing Time(const std::filesystem::path& path, const int repeats)
+{
+  std::vector<double> loads, builds;
+  for (int i = 0; i < repeats; i++)
+  {
+    nam::dspData data;
+    auto start = std::chrono::steady_clock::now();
+    ModelSource::Read(path, data);
+    loads.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    start = std::chrono::steady_clock::now();
+    auto model = nam::get_dsp(data);
+    builds.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+  }
+  Timing timing;
+  timing.load = Median(loads);
+  timing.build = Median(builds);
+  return timing;
+}
+
+double TimeCore(const std::filesystem::path& path, const int repeats)
+{
+  std::vector<double> loads;
+  try
+  {
+    for (int i = 0; i < repeats; i++)
+    {
+      nam::dspData data;
+      const auto start = std::chrono::steady_clock::now();
+      auto model = nam::get_dsp(path, data);
+      loads.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+  }
+  catch (std::exception&)
+  {
+    return 0.0;
+  }
+  return Median(loads);
+}
+
+void PrintHeader()
+{
+  std::printf("%-40s %9s %10s %10s %12s %12s %12s %12s %8s\n", "model", "weights", "size (KB)", ".namb (KB)",
+              "get_dsp (ms)", "load (ms)", ".namb (ms)", "build (ms)", "speedup");
+}
+
+void PrintResult(const Result& r)
+{
+  std::printf("%-40.40s %9zu %10.1f %10.1f %12.3f %12.3f %12.3f %12.3f %7.1fx\n", r.model.c_str(), r.numWeights,
+              r.size / 1024.0, r.binarySize / 1024.0, 1000.0 * r.core, 1000.0 * r.original.load,
+              1000.0 * r.binary.load, 1000.0 * r.original.build, r.original.load / std::max(r.binary.load, 1.0e-12));
+  std::fflush(stdout);
+}
+
+nlohmann::json ToJson(const Timing& t)
+{
+  return {{"load_seconds", t.load}, {"build_seconds", t.build}};
+}
+
+nlohmann::json ToJson(const Result& r)
+{
+  nlohmann::json j;
+  j["model"] = r.model;
+  j["weights"] = r.numWeights;
+  j["size_bytes"] = r.size;
+  j["binary_size_bytes"] = r.binarySize;
+  j["original"] = ToJson(r.original);
+  j["binary"] = ToJson(r.binary);
+  j["get_dsp_seconds"] = r.core;
+  return j;
+}
+}; // namespace
+
+int main(int argc, char* argv[])
+{
+  int repeats = 20;
+  std::string jsonPath;
+  std::vector<std::string> models;
+
+  try
+  {
+    for (int i = 1; i < argc; i++)
+    {
+      const std::string arg(argv[i]);
+      auto next = [&]() -> std::string {
+        if (i + 1 >= argc)
+          throw std::invalid_argument("Missing value for " + arg);
+        return std::string(argv[++i]);
+      };
+      if (arg == "--repeats")
+        repeats = std::max(std::stoi(next()), 1);
+      else if (arg == "--json")
+        jsonPath = next();
+      else if (arg.rfind("--", 0) == 0)
+        throw std::invalid_argument("Unknown option " + arg);
+      else
+        models.push_back(arg);
+    }
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << e.what() << std::endl;
+    std::cerr << "See the top of tools/load_benchmark.cpp for usage." << std::endl;
+    return 1;
+  }
+  if (models.empty())
+    models = {"REAPER/model.nam", "Models/deluxe_reverb_vibrato", "Models/2022-11-14-01_rhythm",
+              "Models/dingwall_bass"};
+
+  // Same as the plugin's constructor
+  nam::activations::Activation::enable_fast_tanh();
+
+  nlohmann::json report;
+  report["repeats"] = repeats;
+  report["results"] = nlohmann::json::array();
+  const std::filesystem::path binaryPath =
+    std::filesystem::temp_directory_path() / (std::string("load_benchmark") + binary_model::kExtension);
+
+  try
+  {
+    PrintHeader();
+    for (const auto& modelPath : models)
+    {
+      const auto path = std::filesystem::u8path(modelPath);
+      Result result;
+      result.model = modelPath;
+      {
+        nam::dspData data;
+        ModelSource::Read(path, data);
+        result.numWeights = data.weights.size();
+        binary_model::Write(binaryPath, data);
+      }
+      result.size = GetSize(path);
+      result.binarySize = GetSize(binaryPath);
+      result.original = Time(path, repeats);
+      result.binary = Time(binaryPath, repeats);
+      result.core = TimeCore(path, repeats);
+      PrintResult(result);
+      report["results"].push_back(ToJson(result));
+    }
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << e.what() << std::endl;
+    std::filesystem::remove(binaryPath);
+    return 1;
+  }
+  std::filesystem::remove(binaryPath);
+
+  if (!jsonPath.empty())
+  {
+    std::ofstream out(jsonPath);
+    out << report.dump(2) << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,208 @@
+// Offline render through the plugin's processing chain, without iPlug2 or a GUI.
+//
+// Usage:
+//   render [options] <model (.nam or directory)> <input.wav> <output.wav>
+//
+// Options mirror the plugin's parameters:
+//   --ir <path>                   Impulse response (.wav)
+//   --ir-trim                     Trim the IR's tail
+//   --ir-trim-threshold <dB>      Energy that trimming the IR can leave out
+//   --ir-minimum-phase            Convert the IR to minimum phase
+//   --input <dB>                  Input level
+//   --output <dB>                 Output level
+//   --threshold <dB>              Noise gate threshold
+//   --no-gate                     Noise gate off
+//   --gate-attack, --gate-hold, --gate-release <ms>
+//   --bass, --middle, --treble <0-10>
+//   --no-eq                       Tone stack off
+//   --output-mode <raw|normalized|calibrated>
+//   --calibrate-input <dBu>       Turns on input calibration at the given level
+//   --slim <0-1>
+//   --block-size <n>              Host buffer size (default 64)
+//
+// Built with the NAM_RT_SANITIZER CMake option, anything real-time-unsafe that the processing does is reported and
+// the exit code is 2 (see NeuralAmpModeler/RealtimeSanitizer.h).
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../NeuralAmpModelerCore/NAM/activations.h"
+#include "../NeuralAmpModeler/RealtimeSanitizer.h"
+
+#include "common.h"
+
+namespace
+{
+void PrintUsage(const char* name)
+{
+  std::cerr << "Usage: " << name << " [options] <model> <input.wav> <output.wav>" << std::endl;
+  std::cerr << "See the top of tools/render.cpp for the options." << std::endl;
+}
+
+int ParseOutputMode(const std::string& s)
+{
+  if (s == "raw")
+    return 0;
+  if (s == "normalized")
+    return 1;
+  if (s == "calibrated")
+    return 2;
+  throw std::invalid_argument("Unknown output mode " + s);
+}
+}; // namespace
+
+int main(int argc, char* argv[])
+{
+  nam_tools::PluginParameters params;
+  std::string irPath;
+  int blockSize = 64;
+  std::vector<std::string> positional;
+
+  try
+  {
+    for (int i = 1; i < argc; i++)
+    {
+      const std::string arg(argv[i]);
+      auto next = [&]() -> std::string {
+        if (i + 1 >= argc)
+          throw std::invalid_argument("Missing value for " + arg);
+        return std::string(argv[++i]);
+      };
+      if (arg == "--ir")
+        irPath = next();
+      else if (arg == "--ir-trim")
+        params.irTrim = true;
+      else if (arg == "--ir-trim-threshold")
+        params.irTrimThreshold = std::stod(next());
+      else if (arg == "--ir-minimum-phase")
+        params.irMinimumPhase = true;
+      else if (arg == "--input")
+        params.inputLevel = std::stod(next());
+      else if (arg == "--output")
+        params.outputLevel = std::stod(next());
+      else if (arg == "--threshold")
+        params.noiseGateThreshold = std::stod(next());
+      else if (arg == "--no-gate")
+        params.noiseGateActive = false;
+      else if (arg == "--gate-attack")
+        params.noiseGateAttack = std::stod(next());
+      else if (arg == "--gate-hold")
+        params.noiseGateHold = std::stod(next());
+      else if (arg == "--gate-release")
+        params.noiseGateRelease = std::stod(next());
+      else if (arg == "--bass")
+        params.bass = std::stod(next());
+      else if (arg == "--middle")
+        params.middle = std::stod(next());
+      else if (arg == "--treble")
+        params.treble = std::stod(next());
+      else if (arg == "--no-eq")
+        params.eqActive = false;
+      else if (arg == "--output-mode")
+        params.outputMode = ParseOutputMode(next());
+      else if (arg == "--calibrate-input")
+      {
+        params.calibrateInput = true;
+        params.inputCalibrationLevel = std::stod(next());
+      }
+      else if (arg == "--slim")
+        params.slim = std::stod(next());
+      else if (arg == "--block-size")
+        blockSize = std::stoi(next());
+      else if (arg.rfind("--", 0) == 0)
+        throw std::invalid_argument("Unknown option " + arg);
+      else
+        positional.push_back(arg);
+    }
+    if (positional.size() != 3 || blockSize <= 0)
+    {
+      PrintUsage(argv[0]);
+      return 1;
+    }
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << e.what() << std::endl;
+    PrintUsage(argv[0]);
+    return 1;
+  }
+  const std::string& modelPath = positional[0];
+  const std::string& inputPath = positional[1];
+  const std::string& outputPath = positional[2];
+
+  // Same as the plugin's constructor
+  nam::activations::Activation::enable_fast_tanh();
+
+  try
+  {
+    double sampleRate = 0.0;
+    const std::vector<float> input = nam_tools::ReadWav(inputPath, sampleRate);
+
+    std::unique_ptr<ResamplingNAM> model = nam_tools::LoadModel(modelPath, sampleRate, blockSize, params.slim);
+    std::unique_ptr<ConvolutionIR> ir;
+    if (!irPath.empty())
+      ir = nam_tools::LoadIR(irPath, sampleRate, blockSize, params.GetIRProcessing());
+
+    ProcessingChain chain;
+    chain.Reset(sampleRate, blockSize);
+    const ProcessingChain::BlockSettings settings = params.GetBlockSettings(model.get());
+    ConvolutionIR* activeIR = params.irToggle ? ir.get() : nullptr;
+
+    std::vector<DSP_SAMPLE> inputBlock(blockSize), outputBlock(blockSize);
+    DSP_SAMPLE* inputPointers[1] = {inputBlock.data()};
+    DSP_SAMPLE* outputPointers[1] = {outputBlock.data()};
+    std::vector<float> output(input.size());
+
+    std::chrono::steady_clock::duration processingTime(0);
+    for (size_t start = 0; start < input.size(); start += blockSize)
+    {
+      const size_t numFrames = std::min((size_t)blockSize, input.size() - start);
+      for (size_t s = 0; s < numFrames; s++)
+        inputBlock[s] = input[start + s];
+
+      const auto t0 = std::chrono::steady_clock::now();
+      {
+        NAM_REALTIME_SCOPE();
+        chain.Process(inputPointers, outputPointers, 1, 1, numFrames, model.get(), activeIR, settings);
+      }
+      processingTime += std::chrono::steady_clock::now() - t0;
+
+      for (size_t s = 0; s < numFrames; s++)
+        output[start + s] = (float)outputBlock[s];
+    }
+    nam_tools::WriteWav(outputPath, output, sampleRate);
+
+    const double audioSeconds = (double)input.size() / sampleRate;
+    const double processingSeconds = std::chrono::duration<double>(processingTime).count();
+    std::cout << "Model:               " << modelPath << std::endl;
+    std::cout << "Sample rate:         " << sampleRate << " Hz (model: " << model->GetEncapsulatedSampleRate()
+              << " Hz)" << std::endl;
+    std::cout << "Block size:          " << blockSize << std::endl;
+    if (ir != nullptr)
+    {
+      std::cout << "IR taps:             " << ir->GetLength() << " (of "
+                << ir->GetSource()->GetUnprocessedLength(sampleRate) << ")" << std::endl;
+    }
+    std::cout << "Precision:           " << (sizeof(DSP_SAMPLE) == sizeof(float) ? "single" : "double") << std::endl;
+    std::cout << "Audio:               " << audioSeconds << " s" << std::endl;
+    std::cout << "Processing:          " << processingSeconds << " s" << std::endl;
+    std::cout << "Real-time factor:    " << processingSeconds / audioSeconds << std::endl;
+    std::cout << "Faster than real-time: " << audioSeconds / processingSeconds << "x" << std::endl;
+#ifdef NAM_RT_SANITIZER
+    const size_t numViolations = rt_sanitizer::GetNumViolations();
+    std::cout << "Real-time violations: " << numViolations << std::endl;
+    if (numViolations > 0)
+      return 2;
+#endif
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,316 @@
+// Hooks behind NAM_REALTIME_SCOPE() (see NeuralAmpModeler/RealtimeSanitizer.h).
+//
+// operator new/delete are checked everywhere. malloc & co., mutexes, sleeping, and file I/O are interposed on Linux
+// (glibc) only.
+//
+// The first few violations are printed with a call stack; after that they're only counted.
+// Set NAM_RT_SANITIZER_ABORT=1 in the environment to abort on the first one instead.
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#if defined(__linux__) || defined(__APPLE__)
+  #include <execinfo.h>
+  #include <unistd.h>
+  #define NAM_RT_SANITIZER_HAVE_BACKTRACE
+#endif
+#if defined(__linux__) && defined(__GLIBC__)
+  #include <dlfcn.h>
+  #include <fcntl.h>
+  #include <pthread.h>
+  #include <time.h>
+  #define NAM_RT_SANITIZER_INTERPOSE
+#endif
+
+#include "../NeuralAmpModeler/RealtimeSanitizer.h"
+
+namespace
+{
+const size_t kMaxReports = 10;
+const int kMaxStackDepth = 32;
+
+thread_local int tRealtimeDepth = 0;
+// Set while reporting so that whatever the reporting does isn't reported.
+thread_local bool tReporting = false;
+std::atomic<size_t> gNumViolations{0};
+
+// Nothing is reported while one of these exists.
+class ScopedQuiet
+{
+public:
+  ScopedQuiet()
+  : mWasReporting(tReporting)
+  {
+    tReporting = true;
+  }
+  ~ScopedQuiet() { tReporting = mWasReporting; }
+
+private:
+  const bool mWasReporting;
+};
+
+void WriteError(const char* s)
+{
+#ifdef NAM_RT_SANITIZER_HAVE_BACKTRACE
+  // Best effort
+  [[maybe_unused]] const auto written = ::write(2, s, std::strlen(s));
+#endif
+}
+
+void Check(const char* what)
+{
+  if (tRealtimeDepth == 0 || tReporting)
+    return;
+  ScopedQuiet quiet;
+  const size_t n = gNumViolations.fetch_add(1) + 1;
+  if (n <= kMaxReports)
+  {
+    WriteError("[rt-sanitizer] ");
+    WriteError(what);
+    WriteError(" in a real-time scope\n");
+#ifdef NAM_RT_SANITIZER_HAVE_BACKTRACE
+    void* stack[kMaxStackDepth];
+    const int depth = backtrace(stack, kMaxStackDepth);
+    backtrace_symbols_fd(stack, depth, 2);
+#endif
+    if (n == kMaxReports)
+      WriteError("[rt-sanitizer] Not printing any more; see the count at the end.\n");
+  }
+  const char* abortSetting = std::getenv("NAM_RT_SANITIZER_ABORT");
+  if (abortSetting != nullptr && std::strcmp(abortSetting, "1") == 0)
+    std::abort();
+}
+
+#ifdef NAM_RT_SANITIZER_HAVE_BACKTRACE
+// backtrace() allocates the first time it's called (it loads libgcc), so get that over with at startup.
+struct WarmUpBacktrace
+{
+  WarmUpBacktrace()
+  {
+    void* stack[1];
+    backtrace(stack, 1);
+  }
+} gWarmUpBacktrace;
+#endif
+}; // namespace
+
+namespace rt_sanitizer
+{
+ScopedRealtime::ScopedRealtime()
+{
+  tRealtimeDepth++;
+}
+
+ScopedRealtime::~ScopedRealtime()
+{
+  tRealtimeDepth--;
+}
+
+size_t GetNumViolations()
+{
+  return gNumViolations.load();
+}
+}; // namespace rt_sanitizer
+
+// C allocation, locks, and blocking calls
+#ifdef NAM_RT_SANITIZER_INTERPOSE
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t num, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* ptr);
+
+void* malloc(size_t size)
+{
+  Check("malloc");
+  return __libc_malloc(size);
+}
+
+void* calloc(size_t num, size_t size)
+{
+  Check("calloc");
+  return __libc_calloc(num, size);
+}
+
+void* realloc(void* ptr, size_t size)
+{
+  Check("realloc");
+  return __libc_realloc(ptr, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size)
+{
+  Check("aligned_alloc");
+  return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** ptr, size_t alignment, size_t size)
+{
+  Check("posix_memalign");
+  *ptr = __libc_memalign(alignment, size);
+  return *ptr == nullptr ? ENOMEM : 0;
+}
+
+void free(void* ptr)
+{
+  if (ptr != nullptr)
+    Check("free");
+  __libc_free(ptr);
+}
+}
+
+// The rest go through the next definition along.
+  #define NAM_RT_SANITIZER_FORWARD(returnType, name, params, args)                                               \
+    extern "C" returnType name params                                                                            \
+    {                                                                                                            \
+      Check(#name);                                                                                              \
+      static auto real = reinterpret_cast<returnType(*) params>(dlsym(RTLD_NEXT, #name));                       \
+      return real args;                                                                                          \
+    }
+
+NAM_RT_SANITIZER_FORWARD(int, pthread_mutex_lock, (pthread_mutex_t * mutex), (mutex))
+NAM_RT_SANITIZER_FORWARD(int, pthread_cond_wait, (pthread_cond_t * cond, pthread_mutex_t* mutex), (cond, mutex))
+NAM_RT_SANITIZER_FORWARD(int, pthread_join, (pthread_t thread, void** ret), (thread, ret))
+NAM_RT_SANITIZER_FORWARD(int, nanosleep, (const struct timespec* req, struct timespec* rem), (req, rem))
+NAM_RT_SANITIZER_FORWARD(int, usleep, (useconds_t usec), (usec))
+NAM_RT_SANITIZER_FORWARD(unsigned int, sleep, (unsigned int seconds), (seconds))
+NAM_RT_SANITIZER_FORWARD(ssize_t, read, (int fd, void* buf, size_t count), (fd, buf, count))
+NAM_RT_SANITIZER_FORWARD(ssize_t, write, (int fd, const void* buf, size_t count), (fd, buf, count))
+NAM_RT_SANITIZER_FORWARD(int, close, (int fd), (fd))
+NAM_RT_SANITIZER_FORWARD(FILE*, fopen, (const char* path, const char* mode), (path, mode))
+
+extern "C" int open(const char* path, int flags, ...)
+{
+  Check("open");
+  mode_t mode = 0;
+  if (flags & O_CREAT)
+  {
+    va_list args;
+    va_start(args, flags);
+    mode = va_arg(args, mode_t);
+    va_end(args);
+  }
+  static auto real = reinterpret_cast<int (*)(const char*, int, ...)>(dlsym(RTLD_NEXT, "open"));
+  return real(path, flags, mode);
+}
+#endif
+
+// C++ allocation
+// Everything goes to malloc/free so that the two pairs of hooks don't both report the same thing.
+namespace
+{
+void* New(const size_t size)
+{
+  Check("operator new");
+  void* p = nullptr;
+  {
+    ScopedQuiet quiet; // Don't report the malloc too.
+    p = std::malloc(size == 0 ? 1 : size);
+  }
+  if (p == nullptr)
+    throw std::bad_alloc();
+  return p;
+}
+
+void* NewAligned(const size_t size, const std::align_val_t alignment)
+{
+  Check("operator new");
+  const size_t a = std::max((size_t)alignment, sizeof(void*));
+  void* p = nullptr;
+  {
+    ScopedQuiet quiet;
+    p = std::aligned_alloc(a, (std::max(size, (size_t)1) + a - 1) / a * a);
+  }
+  if (p == nullptr)
+    throw std::bad_alloc();
+  return p;
+}
+
+void Delete(void* p)
+{
+  if (p == nullptr)
+    return;
+  Check("operator delete");
+  ScopedQuiet quiet;
+  std::free(p);
+}
+}; // namespace
+
+void* operator new(size_t size)
+{
+  return New(size);
+}
+void* operator new[](size_t size)
+{
+  return New(size);
+}
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+  try
+  {
+    return New(size);
+  }
+  catch (...)
+  {
+    return nullptr;
+  }
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+  try
+  {
+    return New(size);
+  }
+  catch (...)
+  {
+    return nullptr;
+  }
+}
+void* operator new(size_t size, std::align_val_t alignment)
+{
+  return NewAligned(size, alignment);
+}
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+  return NewAligned(size, alignment);
+}
+void operator delete(void* p) noexcept
+{
+  Delete(p);
+}
+void operator delete[](void* p) noexcept
+{
+  Delete(p);
+}
+void operator delete(void* p, size_t) noexcept
+{
+  Delete(p);
+}
+void operator delete[](void* p, size_t) noexcept
+{
+  Delete(p);
+}
+void operator delete(void* p, std::align_val_t) noexcept
+{
+  Delete(p);
+}
+void operator delete[](void* p, std::align_val_t) noexcept
+{
+  Delete(p);
+}
+void operator delete(void* p, size_t, std::align_val_t) noexcept
+{
+  Delete(p);
+}
+void operator delete[](void* p, size_t, std::align_val_t) noexcept
+{
+  Delete(p);
+}
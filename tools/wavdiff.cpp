@@ -0,0 +1,105 @@
+// How far one render is from another, e.g. single vs. double precision:
+//   render model.nam in.wav double.wav && render_float model.nam in.wav float.wav
+//   wavdiff double.wav float.wav
+//
+// Usage:
+//   wavdiff [--max-error <dB>] <reference.wav> <test.wav>
+//
+// Prints the peak and RMS error (dBFS) and the signal-to-error ratio (dB).
+// With --max-error, exits with 1 if the peak error is above the given level.
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "common.h"
+
+namespace
+{
+double AmpToDB(const double x)
+{
+  // Don't go to -inf when the two are identical.
+  return 20.0 * std::log10(std::max(x, 1.0e-20));
+}
+
+void PrintUsage(const char* name)
+{
+  std::cerr << "Usage: " << name << " [--max-error <dB>] <reference.wav> <test.wav>" << std::endl;
+}
+}; // namespace
+
+int main(int argc, char* argv[])
+{
+  bool checkMaxError = false;
+  double maxErrorDB = 0.0;
+  std::vector<std::string> positional;
+  try
+  {
+    for (int i = 1; i < argc; i++)
+    {
+      const std::string arg(argv[i]);
+      if (arg == "--max-error" && i + 1 < argc)
+      {
+        checkMaxError = true;
+        maxErrorDB = std::stod(argv[++i]);
+      }
+      else if (arg.rfind("--", 0) == 0)
+        throw std::invalid_argument("Unknown option " + arg);
+      else
+        positional.push_back(arg);
+    }
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << e.what() << std::endl;
+    PrintUsage(argv[0]);
+    return 1;
+  }
+  if (positional.size() != 2)
+  {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+
+  try
+  {
+    double referenceSampleRate = 0.0, testSampleRate = 0.0;
+    const std::vector<float> reference = nam_tools::ReadWav(positional[0], referenceSampleRate);
+    const std::vector<float> test = nam_tools::ReadWav(positional[1], testSampleRate);
+    if (referenceSampleRate != testSampleRate)
+      throw std::runtime_error("Sample rates don't match");
+    if (reference.size() != test.size())
+      throw std::runtime_error("Lengths don't match");
+    if (reference.empty())
+      throw std::runtime_error("Nothing to compare");
+
+    double peakError = 0.0, sumSquaredError = 0.0, sumSquaredReference = 0.0;
+    for (size_t i = 0; i < reference.size(); i++)
+    {
+      const double error = (double)test[i] - (double)reference[i];
+      peakError = std::max(peakError, std::fabs(error));
+      sumSquaredError += error * error;
+      sumSquaredReference += (double)reference[i] * (double)reference[i];
+    }
+    const double rmsError = std::sqrt(sumSquaredError / (double)reference.size());
+    const double rmsReference = std::sqrt(sumSquaredReference / (double)reference.size());
+
+    std::cout << "Peak error:         " << AmpToDB(peakError) << " dBFS" << std::endl;
+    std::cout << "RMS error:          " << AmpToDB(rmsError) << " dBFS" << std::endl;
+    std::cout << "Signal-to-error:    " << AmpToDB(rmsReference) - AmpToDB(rmsError) << " dB" << std::endl;
+
+    if (checkMaxError && AmpToDB(peakError) > maxErrorDB)
+    {
+      std::cerr << "Peak error is above " << maxErrorDB << " dBFS" << std::endl;
+      return 1;
+    }
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}